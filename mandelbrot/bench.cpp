@@ -0,0 +1,264 @@
+#include "complex.hpp"
+#include "complex_batch.hpp"
+#include "mandelbrot.hpp"
+
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using complex     = Complex<double>;
+using std_complex = std::complex<double>;
+
+constexpr std::size_t n_values = 1 << 16;
+constexpr int repetitions      = 200;
+
+// keep the compiler from optimizing away the results
+volatile double sink;
+
+// nanoseconds per value of f, which processes all the values once
+template<typename F>
+double time_ns(F f)
+{
+  f();
+  auto const start = std::chrono::steady_clock::now();
+  for (int r = 0; r != repetitions; ++r) {
+    f();
+  }
+  std::chrono::duration<double, std::nano> const elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (double{n_values} * repetitions);
+}
+
+struct Data
+{
+  std::vector<complex> in1;
+  std::vector<complex> in2;
+  std::vector<std_complex> std_in1;
+  std::vector<std_complex> std_in2;
+  std::vector<complex> out = std::vector<complex>(n_values);
+  std::vector<std_complex> std_out = std::vector<std_complex>(n_values);
+  std::vector<double> real_out = std::vector<double>(n_values);
+
+  Data()
+  {
+    std::mt19937 eng;
+    std::uniform_real_distribution<double> flat{-2., 2.};
+    for (std::size_t i = 0; i != n_values; ++i) {
+      in1.emplace_back(flat(eng), flat(eng));
+      in2.emplace_back(flat(eng), flat(eng));
+      std_in1.emplace_back(in1.back().real(), in1.back().imag());
+      std_in2.emplace_back(in2.back().real(), in2.back().imag());
+    }
+  }
+};
+
+void report(char const* name, double std_ns, double scalar_ns,
+            double batch_ns)
+{
+  std::printf("%-10s %12.2f %12.2f %12.2f %9.1fx\n", name, std_ns, scalar_ns,
+              batch_ns, std_ns / batch_ns);
+}
+
+// compare, for a unary function, std::complex, the scalar Complex function
+// and its batch version
+template<typename StdF, typename ScalarF, typename BatchF>
+void bench_unary(Data& d, char const* name, StdF std_f, ScalarF scalar_f,
+                 BatchF batch_f)
+{
+  auto const std_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.std_out[i] = std_f(d.std_in1[i]);
+    }
+    sink = d.std_out[0].real();
+  });
+  auto const scalar_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.out[i] = scalar_f(d.in1[i]);
+    }
+    sink = d.out[0].real();
+  });
+  auto const batch_ns = time_ns([&] {
+    batch_f(d.in1.data(), d.out.data(), n_values);
+    sink = d.out[0].real();
+  });
+  report(name, std_ns, scalar_ns, batch_ns);
+}
+
+template<typename StdF, typename ScalarF, typename BatchF>
+void bench_binary(Data& d, char const* name, StdF std_f, ScalarF scalar_f,
+                  BatchF batch_f)
+{
+  auto const std_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.std_out[i] = std_f(d.std_in1[i], d.std_in2[i]);
+    }
+    sink = d.std_out[0].real();
+  });
+  auto const scalar_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.out[i] = scalar_f(d.in1[i], d.in2[i]);
+    }
+    sink = d.out[0].real();
+  });
+  auto const batch_ns = time_ns([&] {
+    batch_f(d.in1.data(), d.in2.data(), d.out.data(), n_values);
+    sink = d.out[0].real();
+  });
+  report(name, std_ns, scalar_ns, batch_ns);
+}
+
+template<typename StdF, typename ScalarF, typename BatchF>
+void bench_real(Data& d, char const* name, StdF std_f, ScalarF scalar_f,
+                BatchF batch_f)
+{
+  auto const std_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.real_out[i] = std_f(d.std_in1[i]);
+    }
+    sink = d.real_out[0];
+  });
+  auto const scalar_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.real_out[i] = scalar_f(d.in1[i]);
+    }
+    sink = d.real_out[0];
+  });
+  auto const batch_ns = time_ns([&] {
+    batch_f(d.in1.data(), d.real_out.data(), n_values);
+    sink = d.real_out[0];
+  });
+  report(name, std_ns, scalar_ns, batch_ns);
+}
+
+void bench_complex()
+{
+  Data d;
+  std::printf("%-10s %12s %12s %12s %10s\n", "ns/value", "std::complex",
+              "Complex", "batch", "speedup");
+
+  bench_binary(
+      d, "multiply", [](auto a, auto b) { return a * b; },
+      [](auto a, auto b) { return a * b; },
+      [](auto... args) { multiply(args...); });
+  bench_binary(
+      d, "divide", [](auto a, auto b) { return a / b; },
+      [](auto a, auto b) { return a / b; },
+      [](auto... args) { divide(args...); });
+  bench_unary(
+      d, "conj", [](auto c) { return std::conj(c); },
+      [](auto c) { return conj(c); }, [](auto... args) { conj(args...); });
+  bench_real(
+      d, "abs", [](auto c) { return std::abs(c); },
+      [](auto c) { return abs(c); }, [](auto... args) { abs(args...); });
+  bench_real(
+      d, "arg", [](auto c) { return std::arg(c); },
+      [](auto c) { return arg(c); }, [](auto... args) { arg(args...); });
+  bench_unary(
+      d, "exp", [](auto c) { return std::exp(c); },
+      [](auto c) { return exp(c); }, [](auto... args) { exp(args...); });
+  bench_unary(
+      d, "log", [](auto c) { return std::log(c); },
+      [](auto c) { return log(c); }, [](auto... args) { log(args...); });
+  bench_binary(
+      d, "pow", [](auto a, auto b) { return std::pow(a, b); },
+      [](auto a, auto b) { return pow(a, b); },
+      [](auto... args) { pow(args...); });
+
+  // polar takes two real arrays
+  std::vector<double> rho(n_values);
+  std::vector<double> theta(n_values);
+  for (std::size_t i = 0; i != n_values; ++i) {
+    rho[i]   = abs(d.in1[i]);
+    theta[i] = arg(d.in1[i]);
+  }
+  auto const std_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.std_out[i] = std::polar(rho[i], theta[i]);
+    }
+    sink = d.std_out[0].real();
+  });
+  auto const scalar_ns = time_ns([&] {
+    for (std::size_t i = 0; i != n_values; ++i) {
+      d.out[i] = polar(rho[i], theta[i]);
+    }
+    sink = d.out[0].real();
+  });
+  auto const batch_ns = time_ns([&] {
+    polar(rho.data(), theta.data(), d.out.data(), n_values);
+    sink = d.out[0].real();
+  });
+  report("polar", std_ns, scalar_ns, batch_ns);
+}
+
+// time per pixel of the escape-time kernel, one pixel at a time and eight
+// interleaved, over the region shown by the interactive program, for the
+// bailout radius used by the program, sqrt(2), and for the usual one, 2
+void bench_kernel(int max_iter)
+{
+  constexpr int size = 320;
+  std::vector<complex> points;
+  for (int row = 0; row != size; ++row) {
+    for (int column = 0; column != size; ++column) {
+      points.emplace_back(-2.2 + 3. / size * column, 1.5 - 3. / size * row);
+    }
+  }
+  std::vector<int> k(points.size());
+  auto time_kernel = [&](auto kernel) {
+    auto const start = std::chrono::steady_clock::now();
+    for (int r = 0; r != 5; ++r) {
+      kernel();
+    }
+    std::chrono::duration<double, std::nano> const elapsed =
+        std::chrono::steady_clock::now() - start;
+    long sum = 0;
+    for (auto i : k) {
+      sum += i;
+    }
+    sink = sum;
+    return std::pair{elapsed.count() / (5 * points.size()), sum};
+  };
+  auto const n = static_cast<int>(points.size());
+
+  double ns[4];
+  long sums[4];
+  // runtime values, so that the kernels are not specialized for them
+  volatile double bailouts[2] = {2., 4.};
+  for (int b = 0; b != 2; ++b) {
+    double const bailout = bailouts[b];
+    std::tie(ns[2 * b], sums[2 * b]) = time_kernel([&] {
+      for (int i = 0; i != n; ++i) {
+        k[i] = mandelbrot(points[i], max_iter, bailout);
+      }
+    });
+    std::tie(ns[2 * b + 1], sums[2 * b + 1]) = time_kernel(
+        [&] { mandelbrot(points.data(), k.data(), n, max_iter, bailout); });
+  }
+  std::printf("%-10d %10.2f %10.2f %7.2fx %10.2f %10.2f %7.2fx %s\n", max_iter,
+              ns[0], ns[1], ns[0] / ns[1], ns[2], ns[3], ns[2] / ns[3],
+              sums[0] == sums[1] && sums[2] == sums[3] ? "" : "MISMATCH");
+}
+
+void bench_kernels()
+{
+  std::printf("\n%-10s %30s %30s\n", "ns/pixel", "bailout sqrt(2)",
+              "bailout 2");
+  std::printf("%-10s %10s %10s %8s %10s %10s %8s\n", "max_iter", "single",
+              "8 at once", "speedup", "single", "8 at once", "speedup");
+  // runtime values, so that the kernels are not specialized for them
+  for (volatile int max_iter : {64, 256, 1024}) {
+    bench_kernel(max_iter);
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  bench_complex();
+  bench_kernels();
+}
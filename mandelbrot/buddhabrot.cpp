@@ -0,0 +1,311 @@
+#include "buddhabrot.hpp"
+
+#include "mandelbrot.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using complex = Complex<double>;
+
+// samples are drawn in the square [-2, 2] x [-2, 2], which contains the whole
+// set
+constexpr double domain_min  = -2.;
+constexpr double domain_size = 4.;
+// resolution of the grid used to locate the boundary of the set
+constexpr int boundary_grid = 256;
+// samples sharing the same random stream
+constexpr std::uint64_t chunk_size = 1 << 16;
+
+class Sampler
+{
+  std::vector<bool> is_boundary_;
+  std::vector<int> boundary_cells_;
+  double boundary_fraction_;
+
+  static double cell_size()
+  {
+    return domain_size / boundary_grid;
+  }
+
+ public:
+  Sampler(int max_iter, double boundary_fraction)
+      : is_boundary_(boundary_grid * boundary_grid)
+      , boundary_fraction_{boundary_fraction}
+  {
+    // a cell crosses the boundary if some of its corners belong to the set
+    // and some don't
+    auto const n_corners = boundary_grid + 1;
+    std::vector<bool> inside(n_corners * n_corners);
+    for (int row = 0; row != n_corners; ++row) {
+      for (int column = 0; column != n_corners; ++column) {
+        complex const c{domain_min + column * cell_size(),
+                        domain_min + row * cell_size()};
+        inside[row * n_corners + column] =
+            mandelbrot(c, max_iter, 4.) == max_iter;
+      }
+    }
+    for (int row = 0; row != boundary_grid; ++row) {
+      for (int column = 0; column != boundary_grid; ++column) {
+        auto const corner = row * n_corners + column;
+        auto const n_inside = inside[corner] + inside[corner + 1]
+                            + inside[corner + n_corners]
+                            + inside[corner + n_corners + 1];
+        if (n_inside != 0 && n_inside != 4) {
+          is_boundary_[row * boundary_grid + column] = true;
+          boundary_cells_.push_back(row * boundary_grid + column);
+        }
+      }
+    }
+    if (boundary_cells_.empty()) {
+      boundary_fraction_ = 0.;
+    }
+  }
+
+  // draw a point and return it together with its importance weight, i.e. the
+  // ratio between the uniform density and the density actually sampled
+  template<typename Engine>
+  std::pair<complex, double> operator()(Engine& eng) const
+  {
+    std::uniform_real_distribution<double> flat;
+    complex c;
+    if (flat(eng) < boundary_fraction_) {
+      std::uniform_int_distribution<std::size_t> pick{
+          0, boundary_cells_.size() - 1};
+      auto const cell = boundary_cells_[pick(eng)];
+      c = complex{
+          domain_min + (cell % boundary_grid + flat(eng)) * cell_size(),
+          domain_min + (cell / boundary_grid + flat(eng)) * cell_size()};
+    } else {
+      c = complex{domain_min + flat(eng) * domain_size,
+                  domain_min + flat(eng) * domain_size};
+    }
+    auto const column = std::min(
+        static_cast<int>((c.real() - domain_min) / cell_size()),
+        boundary_grid - 1);
+    auto const row = std::min(
+        static_cast<int>((c.imag() - domain_min) / cell_size()),
+        boundary_grid - 1);
+    double density = 1. - boundary_fraction_;
+    if (is_boundary_[row * boundary_grid + column]) {
+      density += boundary_fraction_ * boundary_grid * boundary_grid
+               / boundary_cells_.size();
+    }
+    return {c, 1. / density};
+  }
+};
+
+void accumulate_orbit(BuddhabrotOptions const& o, complex const& c,
+                      double weight, std::vector<double>& density)
+{
+  auto const k = mandelbrot(c, o.max_iter, 4.);
+  if (k == o.max_iter || k < o.min_iter) {
+    return;
+  }
+  auto const diff = o.lower_right - o.top_left;
+  auto z = c;
+  for (int i = 0; i != k; ++i) {
+    auto const x = (z.real() - o.top_left.real()) / diff.real() * o.width;
+    auto const y = (z.imag() - o.top_left.imag()) / diff.imag() * o.height;
+    if (x >= 0. && x < o.width && y >= 0. && y < o.height) {
+      density[static_cast<unsigned>(y) * o.width + static_cast<unsigned>(x)] +=
+          weight;
+    }
+    z = z * z + c;
+  }
+}
+
+// The checkpoint is a fixed header, identifying the render and the number of
+// batches completed so far, followed by the density buffer
+struct CheckpointHeader
+{
+  char magic[8];
+  std::uint64_t width;
+  std::uint64_t height;
+  std::uint64_t max_iter;
+  std::uint64_t min_iter;
+  std::uint64_t batch_size;
+  std::uint64_t seed;
+  double boundary_fraction;
+  complex top_left;
+  complex lower_right;
+  std::uint64_t completed_batches;
+};
+
+constexpr char checkpoint_magic[8] = {'B', 'U', 'D', 'D', 'H', 'A', '0', '1'};
+
+CheckpointHeader make_header(BuddhabrotOptions const& o,
+                             std::uint64_t completed_batches)
+{
+  CheckpointHeader h{};
+  std::memcpy(h.magic, checkpoint_magic, sizeof(h.magic));
+  h.width             = o.width;
+  h.height            = o.height;
+  h.max_iter          = o.max_iter;
+  h.min_iter          = o.min_iter;
+  h.batch_size        = o.batch_size;
+  h.seed              = o.seed;
+  h.boundary_fraction = o.boundary_fraction;
+  h.top_left          = o.top_left;
+  h.lower_right       = o.lower_right;
+  h.completed_batches = completed_batches;
+  return h;
+}
+
+void save_checkpoint(BuddhabrotOptions const& o,
+                     std::uint64_t completed_batches,
+                     std::vector<double> const& density)
+{
+  // write to a temporary file and then rename it, so that an interrupted
+  // save never destroys the previous checkpoint
+  auto const tmp = o.checkpoint + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    auto const header = make_header(o, completed_batches);
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    out.write(reinterpret_cast<char const*>(density.data()),
+              density.size() * sizeof(double));
+    if (!out) {
+      throw std::runtime_error("Cannot write checkpoint " + tmp);
+    }
+  }
+  std::filesystem::rename(tmp, o.checkpoint);
+}
+
+// return the number of batches already completed, 0 if there is no checkpoint
+std::uint64_t load_checkpoint(BuddhabrotOptions const& o,
+                              std::vector<double>& density)
+{
+  std::ifstream in(o.checkpoint, std::ios::binary);
+  if (!in) {
+    return 0;
+  }
+  CheckpointHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  auto expected = make_header(o, header.completed_batches);
+  if (!in || std::memcmp(&header, &expected, sizeof(header)) != 0) {
+    throw std::runtime_error("Checkpoint " + o.checkpoint
+                             + " does not match the requested render");
+  }
+  in.read(reinterpret_cast<char*>(density.data()),
+          density.size() * sizeof(double));
+  if (!in) {
+    throw std::runtime_error("Truncated checkpoint " + o.checkpoint);
+  }
+  return header.completed_batches;
+}
+
+}  // namespace
+
+std::vector<double> buddhabrot(BuddhabrotOptions const& o)
+{
+  if (o.width == 0 || o.height == 0 || o.batch_size == 0) {
+    throw std::runtime_error("Empty Buddhabrot render requested");
+  }
+  if (o.boundary_fraction < 0. || o.boundary_fraction >= 1.) {
+    throw std::runtime_error("Boundary fraction must be in [0, 1)");
+  }
+
+  std::vector<double> density(o.width * o.height);
+  auto batch =
+      o.checkpoint.empty() ? std::uint64_t{0} : load_checkpoint(o, density);
+  auto const n_batches = (o.samples + o.batch_size - 1) / o.batch_size;
+
+  Sampler const sampler(o.max_iter, o.boundary_fraction);
+  auto const n_threads =
+      o.n_threads != 0 ? o.n_threads
+                       : std::max(1u, std::thread::hardware_concurrency());
+  // every chunk accumulates into a buffer of its own, added to the density in
+  // chunk order, so the result doesn't depend on which thread renders which
+  // chunk; at most window chunks are rendered ahead of the first one not yet
+  // added, which bounds the buffers in use
+  auto const window = 2 * std::uint64_t{n_threads};
+  std::vector<std::vector<double>> spare;
+
+  for (; batch < n_batches; ++batch) {
+    auto const first = batch * o.batch_size;
+    auto const batch_samples = std::min(o.batch_size, o.samples - first);
+    auto const n_chunks = (batch_samples + chunk_size - 1) / chunk_size;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::map<std::uint64_t, std::vector<double>> ready;
+    std::uint64_t next_chunk = 0;
+    std::uint64_t merged     = 0;
+
+    auto work = [&] {
+      std::unique_lock lock{mutex};
+      while (true) {
+        cv.wait(lock, [&] {
+          return next_chunk == n_chunks || next_chunk < merged + window;
+        });
+        if (next_chunk == n_chunks) {
+          return;
+        }
+        auto const chunk = next_chunk++;
+        std::vector<double> partial;
+        if (spare.empty()) {
+          partial.resize(density.size());
+        } else {
+          partial = std::move(spare.back());
+          spare.pop_back();
+        }
+        lock.unlock();
+
+        // each chunk has its own random stream, so the samples don't depend
+        // on how chunks are distributed among threads
+        std::seed_seq seq{static_cast<std::uint32_t>(o.seed),
+                          static_cast<std::uint32_t>(o.seed >> 32),
+                          static_cast<std::uint32_t>(batch),
+                          static_cast<std::uint32_t>(chunk)};
+        std::mt19937_64 eng{seq};
+        auto const n = std::min(chunk_size, batch_samples - chunk * chunk_size);
+        for (std::uint64_t s = 0; s != n; ++s) {
+          auto const [c, weight] = sampler(eng);
+          accumulate_orbit(o, c, weight, partial);
+        }
+
+        lock.lock();
+        ready.emplace(chunk, std::move(partial));
+        // whoever completes the first chunk not yet added adds it, together
+        // with the ones following it that are already complete
+        for (auto it = ready.find(merged); it != ready.end();
+             it = ready.find(merged)) {
+          auto& p = it->second;
+          std::transform(density.begin(), density.end(), p.begin(),
+                         density.begin(), std::plus<>{});
+          std::fill(p.begin(), p.end(), 0.);
+          spare.push_back(std::move(p));
+          ready.erase(it);
+          ++merged;
+        }
+        cv.notify_all();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < n_threads; ++t) {
+      threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    if (!o.checkpoint.empty()) {
+      save_checkpoint(o, batch + 1, density);
+    }
+  }
+
+  return density;
+}
@@ -0,0 +1,38 @@
+#ifndef BUDDHABROT_HPP
+#define BUDDHABROT_HPP
+
+#include "complex.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BuddhabrotOptions
+{
+  Complex<double> top_left{-2.2, 1.5};
+  Complex<double> lower_right{0.8, -1.5};
+  unsigned width{600};
+  unsigned height{600};
+  int max_iter{1000};
+  // orbits escaping in fewer iterations are not accumulated
+  int min_iter{20};
+  std::uint64_t samples{10'000'000};
+  // samples computed between two checkpoints
+  std::uint64_t batch_size{1'000'000};
+  // fraction of the samples drawn from the cells crossing the set boundary
+  double boundary_fraction{0.5};
+  // 0 means one thread per hardware thread
+  unsigned n_threads{0};
+  std::uint64_t seed{0};
+  // if not empty, the render is resumed from and periodically saved to this
+  // file
+  std::string checkpoint;
+};
+
+// Accumulate the orbits of randomly sampled escaping points into a density
+// buffer of width * height values, stored row by row. Every sample contributes
+// with its importance weight, so the result estimates the hits that the same
+// number of uniformly distributed samples would produce.
+std::vector<double> buddhabrot(BuddhabrotOptions const& options);
+
+#endif
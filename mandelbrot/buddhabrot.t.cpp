@@ -0,0 +1,56 @@
+#include "buddhabrot.hpp"
+#include "doctest.h"
+
+#include <cstdio>
+#include <numeric>
+
+TEST_CASE("Testing Buddhabrot")
+{
+  BuddhabrotOptions options;
+  options.width      = 64;
+  options.height     = 64;
+  options.max_iter   = 100;
+  options.min_iter   = 5;
+  options.samples    = 40'000;
+  options.batch_size = 10'000;
+  options.n_threads  = 1;
+
+  auto const density = buddhabrot(options);
+  REQUIRE(density.size() == 64 * 64);
+  auto const total = std::accumulate(density.begin(), density.end(), 0.);
+  CHECK(total > 0.);
+
+  SUBCASE("importance sampling is unbiased")
+  {
+    options.boundary_fraction = 0.;
+    options.samples           = 400'000;
+    options.batch_size        = 400'000;
+    auto const uniform        = buddhabrot(options);
+    auto const uniform_total =
+        std::accumulate(uniform.begin(), uniform.end(), 0.) / 10.;
+    CHECK(total == doctest::Approx(uniform_total).epsilon(0.1));
+  }
+
+  SUBCASE("multithreaded render")
+  {
+    options.n_threads   = 3;
+    auto const parallel = buddhabrot(options);
+    // the chunks are added in the same order whatever the number of threads
+    CHECK(parallel == density);
+  }
+
+  SUBCASE("resume from checkpoint")
+  {
+    options.checkpoint = "buddhabrot.t.checkpoint";
+    std::remove(options.checkpoint.c_str());
+    options.samples = 20'000;
+    buddhabrot(options);
+    options.samples    = 40'000;
+    auto const resumed = buddhabrot(options);
+    CHECK(resumed == density);
+
+    options.max_iter = 50;
+    CHECK_THROWS(buddhabrot(options));
+    std::remove(options.checkpoint.c_str());
+  }
+}
@@ -1,6 +1,8 @@
 #ifndef COMPLEX_HPP
 #define COMPLEX_HPP
 
+#include <cmath>
+
 template<typename T>
 class Complex
 {
@@ -53,6 +55,65 @@ auto operator*(Complex<T> const& c1, Complex<T> const& c2)
                  c1.real() * c2.imag() + c1.imag() * c2.real()};
 }
 
+// no rescaling is done, so the result overflows if norm2(c2) does
+template<typename T>
+auto operator/(Complex<T> const& c1, Complex<T> const& c2)
+{
+  auto const d = norm2(c2);
+  return Complex{(c1.real() * c2.real() + c1.imag() * c2.imag()) / d,
+                 (c1.imag() * c2.real() - c1.real() * c2.imag()) / d};
+}
+
+template<typename T>
+auto conj(Complex<T> const& c)
+{
+  return Complex{c.real(), -c.imag()};
+}
+
+template<typename T>
+auto abs(Complex<T> const& c)
+{
+  return std::sqrt(norm2(c));
+}
+
+template<typename T>
+auto arg(Complex<T> const& c)
+{
+  return std::atan2(c.imag(), c.real());
+}
+
+template<typename T>
+auto polar(T rho, T theta)
+{
+  return Complex{rho * std::cos(theta), rho * std::sin(theta)};
+}
+
+template<typename T>
+auto exp(Complex<T> const& c)
+{
+  return polar(std::exp(c.real()), c.imag());
+}
+
+// principal value, with the imaginary part in (-pi, pi]
+template<typename T>
+auto log(Complex<T> const& c)
+{
+  return Complex{std::log(abs(c)), arg(c)};
+}
+
+template<typename T>
+auto pow(Complex<T> const& c1, Complex<T> const& c2)
+{
+  return c1 == Complex<T>{} ? Complex<T>{} : exp(c2 * log(c1));
+}
+
+template<typename T>
+auto pow(Complex<T> const& c, T x)
+{
+  return c == Complex<T>{} ? Complex<T>{}
+                           : polar(std::pow(abs(c), x), x * arg(c));
+}
+
 template<typename T>
 auto operator==(Complex<T> const& c1, Complex<T> const& c2)
 {
@@ -1,6 +1,11 @@
 #include "complex.hpp"
+#include "complex_batch.hpp"
 #include "doctest.h"
 
+#include <cmath>
+#include <complex>
+#include <vector>
+
 TEST_CASE("Testing Complex")
 {
   Complex<double> c{};
@@ -11,3 +16,91 @@ TEST_CASE("Testing Complex")
   CHECK((Complex{1., 2.} + Complex{3., 4.} == Complex{4., 6.}));
   // ...
 }
+
+TEST_CASE("Testing Complex functions")
+{
+  using complex = Complex<double>;
+  using std_complex = std::complex<double>;
+  std::vector<complex> const values{{1., 2.},   {-3., 0.5}, {0.25, -4.},
+                                    {-1., -1.}, {2., 0.},   {0., -2.}};
+  auto same = [](complex c, std_complex s) {
+    return c.real() == doctest::Approx(s.real())
+        && c.imag() == doctest::Approx(s.imag());
+  };
+
+  CHECK((Complex{1., 2.} / Complex{3., 4.} == Complex{0.44, 0.08}));
+  CHECK((conj(Complex{1., 2.}) == Complex{1., -2.}));
+  CHECK(abs(Complex{3., -4.}) == 5.);
+  CHECK(arg(Complex{0., 1.}) == doctest::Approx(M_PI / 2));
+  CHECK(same(polar(2., M_PI / 2), std::polar(2., M_PI / 2)));
+  CHECK((pow(complex{}, complex{2., 1.}) == complex{}));
+
+  for (auto const& c : values) {
+    std_complex const s{c.real(), c.imag()};
+    std_complex const s2{s.imag(), s.real()};
+    CHECK(same(exp(c), std::exp(s)));
+    CHECK(same(log(c), std::log(s)));
+    CHECK(same(pow(c, complex{s2.real(), s2.imag()}), std::pow(s, s2)));
+    CHECK(same(pow(c, 2.5), std::pow(s, 2.5)));
+    CHECK(same(c / complex{s2.real(), s2.imag()}, s / s2));
+  }
+}
+
+TEST_CASE("Testing batch Complex functions")
+{
+  using complex = Complex<double>;
+  // more than a block, to test the remainder
+  std::vector<complex> in1;
+  std::vector<complex> in2;
+  for (int i = 0; i != 300; ++i) {
+    in1.emplace_back(0.01 * i - 1.5, 2. - 0.02 * i);
+    in2.emplace_back(0.5 + 0.003 * i, -0.01 * i);
+  }
+  auto const n = in1.size();
+  std::vector<complex> out(n);
+  std::vector<double> real_out(n);
+  auto same = [](complex c1, complex c2) {
+    return c1.real() == doctest::Approx(c2.real())
+        && c1.imag() == doctest::Approx(c2.imag());
+  };
+  auto check = [&](auto f) {
+    bool ok = true;
+    for (std::size_t i = 0; i != n; ++i) {
+      ok = ok && same(out[i], f(in1[i], in2[i]));
+    }
+    CHECK(ok);
+  };
+
+  conj(in1.data(), out.data(), n);
+  check([](complex c, complex) { return conj(c); });
+  exp(in1.data(), out.data(), n);
+  check([](complex c, complex) { return exp(c); });
+  log(in1.data(), out.data(), n);
+  check([](complex c, complex) { return log(c); });
+  multiply(in1.data(), in2.data(), out.data(), n);
+  check([](complex c1, complex c2) { return c1 * c2; });
+  divide(in1.data(), in2.data(), out.data(), n);
+  check([](complex c1, complex c2) { return c1 / c2; });
+  pow(in1.data(), in2.data(), out.data(), n);
+  check([](complex c1, complex c2) { return pow(c1, c2); });
+
+  abs(in1.data(), real_out.data(), n);
+  bool ok = true;
+  for (std::size_t i = 0; i != n; ++i) {
+    ok = ok && real_out[i] == doctest::Approx(abs(in1[i]));
+  }
+  CHECK(ok);
+  arg(in1.data(), real_out.data(), n);
+  for (std::size_t i = 0; i != n; ++i) {
+    ok = ok && real_out[i] == doctest::Approx(arg(in1[i]));
+  }
+  CHECK(ok);
+
+  std::vector<double> rho(n, 2.);
+  polar(rho.data(), real_out.data(), out.data(), n);
+  check([&](complex c, complex) { return polar(2., arg(c)); });
+
+  std::vector<complex> zero(n);
+  pow(zero.data(), in2.data(), out.data(), n);
+  CHECK((out[0] == complex{}));
+}
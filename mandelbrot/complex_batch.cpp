@@ -0,0 +1,248 @@
+#include "complex_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <math.h>
+
+// This file is compiled with -ffast-math and -fopenmp-simd (see
+// CMakeLists.txt), which allow the compiler to vectorize the loops below and
+// to replace the math functions with their vector versions (e.g. from glibc's
+// libmvec). The inline arithmetic of complex.hpp must not be used here: the
+// copies compiled with -ffast-math could be the ones the linker keeps for the
+// whole program. Only the constructor and the accessors of Complex, which do
+// no arithmetic, are shared.
+
+namespace {
+
+// the same operations as operator* and operator/ in complex.hpp
+template<typename T>
+Complex<T> times(Complex<T> const& c1, Complex<T> const& c2)
+{
+  return Complex<T>{c1.real() * c2.real() - c1.imag() * c2.imag(),
+                    c1.real() * c2.imag() + c1.imag() * c2.real()};
+}
+
+template<typename T>
+Complex<T> over(Complex<T> const& c1, Complex<T> const& c2)
+{
+  auto const d = c2.real() * c2.real() + c2.imag() * c2.imag();
+  return Complex<T>{(c1.real() * c2.real() + c1.imag() * c2.imag()) / d,
+                    (c1.imag() * c2.real() - c1.real() * c2.imag()) / d};
+}
+
+// the float overloads in <cmath> are inline functions as well, so the math
+// library is called through these
+namespace math {
+// clang-format off
+float sqrt(float x) { return ::sqrtf(x); }
+double sqrt(double x) { return ::sqrt(x); }
+float exp(float x) { return ::expf(x); }
+double exp(double x) { return ::exp(x); }
+float log(float x) { return ::logf(x); }
+double log(double x) { return ::log(x); }
+float cos(float x) { return ::cosf(x); }
+double cos(double x) { return ::cos(x); }
+float sin(float x) { return ::sinf(x); }
+double sin(double x) { return ::sin(x); }
+float atan2(float y, float x) { return ::atan2f(y, x); }
+double atan2(double y, double x) { return ::atan2(y, x); }
+// clang-format on
+}  // namespace math
+
+constexpr std::size_t block_size = 256;
+
+// real and imaginary parts of up to block_size values
+template<typename T>
+struct Block
+{
+  alignas(64) T re[block_size];
+  alignas(64) T im[block_size];
+
+  void split(Complex<T> const* in, std::size_t n)
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      re[i] = in[i].real();
+      im[i] = in[i].imag();
+    }
+  }
+
+  // re[i] + i im[i] = rho[i] (cos(theta[i]) + i sin(theta[i])), where theta
+  // may be im but rho must not be re. The cosine and the sine are computed in
+  // separate loops, otherwise the compiler merges them into a call to sincos,
+  // which has no vector version.
+  void polar(T const* rho, T const* theta, std::size_t n)
+  {
+#pragma omp simd
+    for (std::size_t i = 0; i < n; ++i) {
+      re[i] = rho[i] * math::cos(theta[i]);
+    }
+#pragma omp simd
+    for (std::size_t i = 0; i < n; ++i) {
+      im[i] = rho[i] * math::sin(theta[i]);
+    }
+  }
+
+  void join(Complex<T>* out, std::size_t n) const
+  {
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i] = Complex<T>{re[i], im[i]};
+    }
+  }
+};
+
+// call f(first, size) on consecutive blocks covering [0, n)
+template<typename F>
+void for_each_block(std::size_t n, F f)
+{
+  for (std::size_t first = 0; first < n; first += block_size) {
+    f(first, std::min(block_size, n - first));
+  }
+}
+
+}  // namespace
+
+// the arithmetic operations are vectorized as well directly on the
+// interleaved values, without splitting them
+
+template<typename T>
+void conj(Complex<T> const* in, Complex<T>* out, std::size_t n)
+{
+#pragma omp simd
+  for (std::size_t i = 0; i < n; ++i) {
+    out[i] = Complex<T>{in[i].real(), -in[i].imag()};
+  }
+}
+
+template<typename T>
+void multiply(Complex<T> const* in1, Complex<T> const* in2, Complex<T>* out,
+              std::size_t n)
+{
+#pragma omp simd
+  for (std::size_t i = 0; i < n; ++i) {
+    out[i] = times(in1[i], in2[i]);
+  }
+}
+
+template<typename T>
+void divide(Complex<T> const* in1, Complex<T> const* in2, Complex<T>* out,
+            std::size_t n)
+{
+#pragma omp simd
+  for (std::size_t i = 0; i < n; ++i) {
+    out[i] = over(in1[i], in2[i]);
+  }
+}
+
+template<typename T>
+void abs(Complex<T> const* in, T* out, std::size_t n)
+{
+  for_each_block(n, [&](std::size_t first, std::size_t m) {
+    Block<T> b;
+    b.split(in + first, m);
+#pragma omp simd
+    for (std::size_t i = 0; i < m; ++i) {
+      out[first + i] = math::sqrt(b.re[i] * b.re[i] + b.im[i] * b.im[i]);
+    }
+  });
+}
+
+template<typename T>
+void arg(Complex<T> const* in, T* out, std::size_t n)
+{
+  for_each_block(n, [&](std::size_t first, std::size_t m) {
+    Block<T> b;
+    b.split(in + first, m);
+#pragma omp simd
+    for (std::size_t i = 0; i < m; ++i) {
+      out[first + i] = math::atan2(b.im[i], b.re[i]);
+    }
+  });
+}
+
+template<typename T>
+void polar(T const* rho, T const* theta, Complex<T>* out, std::size_t n)
+{
+  for_each_block(n, [&](std::size_t first, std::size_t m) {
+    Block<T> b;
+    b.polar(rho + first, theta + first, m);
+    b.join(out + first, m);
+  });
+}
+
+template<typename T>
+void exp(Complex<T> const* in, Complex<T>* out, std::size_t n)
+{
+  for_each_block(n, [&](std::size_t first, std::size_t m) {
+    Block<T> b;
+    b.split(in + first, m);
+    alignas(64) T rho[block_size];
+#pragma omp simd
+    for (std::size_t i = 0; i < m; ++i) {
+      rho[i] = math::exp(b.re[i]);
+    }
+    b.polar(rho, b.im, m);
+    b.join(out + first, m);
+  });
+}
+
+template<typename T>
+void log(Complex<T> const* in, Complex<T>* out, std::size_t n)
+{
+  for_each_block(n, [&](std::size_t first, std::size_t m) {
+    Block<T> b;
+    b.split(in + first, m);
+#pragma omp simd
+    for (std::size_t i = 0; i < m; ++i) {
+      auto const re = b.re[i];
+      auto const im = b.im[i];
+      b.re[i]       = T{0.5} * math::log(re * re + im * im);
+      b.im[i]       = math::atan2(im, re);
+    }
+    b.join(out + first, m);
+  });
+}
+
+template<typename T>
+void pow(Complex<T> const* in1, Complex<T> const* in2, Complex<T>* out,
+         std::size_t n)
+{
+  for_each_block(n, [&](std::size_t first, std::size_t m) {
+    Block<T> b1;
+    Block<T> b2;
+    b1.split(in1 + first, m);
+    b2.split(in2 + first, m);
+    alignas(64) T rho[block_size];
+#pragma omp simd
+    for (std::size_t i = 0; i < m; ++i) {
+      // exp(c2 * log(c1)), 0 if c1 is 0
+      auto const n2      = b1.re[i] * b1.re[i] + b1.im[i] * b1.im[i];
+      bool const is_zero = n2 == T{0};
+      auto const log_re  = T{0.5} * math::log(is_zero ? T{1} : n2);
+      auto const log_im  = math::atan2(b1.im[i], b1.re[i]);
+      auto const re      = b2.re[i] * log_re - b2.im[i] * log_im;
+      rho[i]             = is_zero ? T{0} : math::exp(re);
+      b1.im[i]           = b2.re[i] * log_im + b2.im[i] * log_re;
+    }
+    b1.polar(rho, b1.im, m);
+    b1.join(out + first, m);
+  });
+}
+
+// clang-format off
+#define INSTANTIATE(T)                                                         \
+  template void conj(Complex<T> const*, Complex<T>*, std::size_t);             \
+  template void abs(Complex<T> const*, T*, std::size_t);                       \
+  template void arg(Complex<T> const*, T*, std::size_t);                       \
+  template void polar(T const*, T const*, Complex<T>*, std::size_t);           \
+  template void exp(Complex<T> const*, Complex<T>*, std::size_t);              \
+  template void log(Complex<T> const*, Complex<T>*, std::size_t);              \
+  template void multiply(Complex<T> const*, Complex<T> const*, Complex<T>*,    \
+                         std::size_t);                                         \
+  template void divide(Complex<T> const*, Complex<T> const*, Complex<T>*,      \
+                       std::size_t);                                           \
+  template void pow(Complex<T> const*, Complex<T> const*, Complex<T>*,         \
+                    std::size_t);
+// clang-format on
+
+INSTANTIATE(float)
+INSTANTIATE(double)
@@ -0,0 +1,45 @@
+#ifndef COMPLEX_BATCH_HPP
+#define COMPLEX_BATCH_HPP
+
+#include "complex.hpp"
+
+#include <cstddef>
+
+// Batch versions of the Complex functions, computing out[i] = f(in[i]) (or
+// f(in1[i], in2[i])) for i in [0, n). The computation is vectorized; the
+// functions relying on the math library process the values in blocks, split
+// into their real and imaginary parts, so that the vector versions of the math
+// functions are called when available. Results can differ by a few ulps from
+// those of the scalar functions, and infinities and NaNs are not supported.
+
+template<typename T>
+void conj(Complex<T> const* in, Complex<T>* out, std::size_t n);
+
+template<typename T>
+void abs(Complex<T> const* in, T* out, std::size_t n);
+
+template<typename T>
+void arg(Complex<T> const* in, T* out, std::size_t n);
+
+template<typename T>
+void polar(T const* rho, T const* theta, Complex<T>* out, std::size_t n);
+
+template<typename T>
+void exp(Complex<T> const* in, Complex<T>* out, std::size_t n);
+
+template<typename T>
+void log(Complex<T> const* in, Complex<T>* out, std::size_t n);
+
+template<typename T>
+void multiply(Complex<T> const* in1, Complex<T> const* in2, Complex<T>* out,
+              std::size_t n);
+
+template<typename T>
+void divide(Complex<T> const* in1, Complex<T> const* in2, Complex<T>* out,
+            std::size_t n);
+
+template<typename T>
+void pow(Complex<T> const* in1, Complex<T> const* in2, Complex<T>* out,
+         std::size_t n);
+
+#endif
@@ -1,30 +1,149 @@
+#include "buddhabrot.hpp"
 #include "complex.hpp"
+#include "mandelbrot.hpp"
+#include "pyramid.hpp"
+#include "stream.hpp"
 #include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 using complex = Complex<double>;
 
-int mandelbrot(complex const& c)
+auto to_color(int k)
+{
+  auto const rgb = to_rgb(k);
+  return sf::Color{rgb.r, rgb.g, rgb.b};
+}
+
+// mandelbrot buddhabrot <output image> [samples] [checkpoint file]
+int render_buddhabrot(std::vector<std::string> const& args)
 {
-  auto i = 0;
-  auto z = c;
-  for (; i != 256 && norm2(z) < 2.; ++i) {
-    z = z * z + c;
+  if (args.size() < 2) {
+    std::cerr << "usage: mandelbrot buddhabrot <output image> [samples] "
+                 "[checkpoint file]\n";
+    return 1;
   }
-  return i;
+  BuddhabrotOptions options;
+  if (args.size() > 2) {
+    options.samples = std::stoull(args[2]);
+  }
+  if (args.size() > 3) {
+    options.checkpoint = args[3];
+  }
+
+  auto const density = buddhabrot(options);
+
+  // square-root tone mapping, to make the faint orbits visible
+  auto const max = *std::max_element(density.begin(), density.end());
+  sf::Image image;
+  image.create(options.width, options.height);
+  for (auto row = 0u; row != options.height; ++row) {
+    for (auto column = 0u; column != options.width; ++column) {
+      auto const d = density[row * options.width + column];
+      auto const v =
+          static_cast<sf::Uint8>(max > 0. ? 255. * std::sqrt(d / max) : 0.);
+      image.setPixel(column, row, sf::Color{v, v, v});
+    }
+  }
+  return image.saveToFile(args[1]) ? 0 : 1;
 }
 
-auto to_color(int k)
+// mandelbrot stream <output tiff> <width> <height> [band height]
+int render_stream(std::vector<std::string> const& args)
+{
+  if (args.size() < 4) {
+    std::cerr << "usage: mandelbrot stream <output tiff> <width> <height> "
+                 "[band height]\n";
+    return 1;
+  }
+  StreamOptions options;
+  options.width  = std::stoul(args[2]);
+  options.height = std::stoul(args[3]);
+  if (args.size() > 4) {
+    options.band_height = std::stoul(args[4]);
+  }
+  render_to_tiff(args[1], options);
+  return 0;
+}
+
+// mandelbrot pyramid <output directory> [max zoom] [render]
+// Tiles are written as <directory>/<z>/<x>/<y>.png, the layout expected by
+// web map viewers. By default a level is obtained downsampling the next one;
+// with "render" each level is rendered directly.
+int render_pyramid(std::vector<std::string> const& args)
 {
-  return k < 256 ? sf::Color{static_cast<sf::Uint8>(10 * k), 0, 0}
-                 : sf::Color::Black;
+  if (args.size() < 2) {
+    std::cerr << "usage: mandelbrot pyramid <output directory> [max zoom] "
+                 "[render]\n";
+    return 1;
+  }
+  std::filesystem::path const root{args[1]};
+  PyramidOptions options;
+  if (args.size() > 2) {
+    options.max_zoom = std::stoul(args[2]);
+  }
+  options.downsample = !(args.size() > 3 && args[3] == "render");
+
+  auto path = [&](TileId id) {
+    return root / std::to_string(id.z) / std::to_string(id.x)
+         / (std::to_string(id.y) + ".png");
+  };
+  std::mutex mutex;
+  auto save = [&](TileId id, Tile const& tile) {
+    auto const file = path(id);
+    {
+      std::lock_guard lock{mutex};
+      std::filesystem::create_directories(file.parent_path());
+    }
+    std::vector<sf::Uint8> pixels;
+    pixels.reserve(4 * tile.size());
+    for (auto const& rgb : tile) {
+      pixels.insert(pixels.end(), {rgb.r, rgb.g, rgb.b, 255});
+    }
+    sf::Image image;
+    image.create(tile_size, tile_size, pixels.data());
+    if (!image.saveToFile(file.string())) {
+      throw std::runtime_error("Cannot write " + file.string());
+    }
+  };
+  auto load = [&](TileId id) {
+    sf::Image image;
+    if (!image.loadFromFile(path(id).string())) {
+      throw std::runtime_error("Cannot read " + path(id).string());
+    }
+    auto const pixels = image.getPixelsPtr();
+    Tile tile(tile_size * tile_size);
+    for (auto i = 0u; i != tile.size(); ++i) {
+      tile[i] = Rgb{pixels[4 * i], pixels[4 * i + 1], pixels[4 * i + 2]};
+    }
+    return tile;
+  };
+
+  build_pyramid(options, save, load);
+  return 0;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+  std::vector<std::string> const args(argv + 1, argv + argc);
+  if (!args.empty() && args[0] == "buddhabrot") {
+    return render_buddhabrot(args);
+  }
+  if (!args.empty() && args[0] == "stream") {
+    return render_stream(args);
+  }
+  if (!args.empty() && args[0] == "pyramid") {
+    return render_pyramid(args);
+  }
+
   auto const display_width  = 600u;
   auto const display_height = 600u;
 
@@ -0,0 +1,108 @@
+#ifndef MANDELBROT_HPP
+#define MANDELBROT_HPP
+
+#include "complex.hpp"
+
+#include <cstdint>
+
+// escape-time kernel: number of iterations before the orbit of c leaves the
+// bailout region, norm2(z) < bailout_norm2, or max_iter if it never does
+template<typename T>
+int mandelbrot(Complex<T> const& c, int max_iter = 256,
+               double bailout_norm2 = 2.)
+{
+  auto i = 0;
+  auto z = c;
+  for (; i != max_iter && norm2(z) < bailout_norm2; ++i) {
+    z = z * z + c;
+  }
+  return i;
+}
+
+// Escape-time kernel for N points at once: k[n] = mandelbrot(c[n], max_iter,
+// bailout_norm2). A single orbit is bound by the latency of the dependent
+// multiplications of z * z + c; the N orbits are independent, so iterated in
+// lock-step their multiplications overlap. An orbit that has escaped keeps
+// its z and its count while the others go on, until all have escaped. The
+// masks and the counts are kept as T, so that the loop over the points is
+// vectorized; max_iter must be exactly representable as T.
+template<int N = 8, typename T>
+void mandelbrot_interleaved(Complex<T> const* c, int* k, int max_iter = 256,
+                            double bailout_norm2 = 2.)
+{
+  T cr[N];
+  T ci[N];
+  T zr[N];
+  T zi[N];
+  T alive[N];
+  T count[N];
+  for (int n = 0; n != N; ++n) {
+    cr[n] = zr[n] = c[n].real();
+    ci[n] = zi[n] = c[n].imag();
+    alive[n] = T{1};
+    count[n] = T{0};
+  }
+  for (int i = 0; i != max_iter; ++i) {
+    T any{0};
+    for (int n = 0; n != N; ++n) {
+      // the same operations as norm2(z) and z * z + c
+      T const a =
+          alive[n] != T{0} && zr[n] * zr[n] + zi[n] * zi[n] < bailout_norm2
+              ? T{1}
+              : T{0};
+      alive[n] = a;
+      count[n] += a;
+      any += a;
+      auto const re = zr[n] * zr[n] - zi[n] * zi[n] + cr[n];
+      auto const im = zr[n] * zi[n] + zi[n] * zr[n] + ci[n];
+      zr[n] = a != T{0} ? re : zr[n];
+      zi[n] = a != T{0} ? im : zi[n];
+    }
+    if (any == T{0}) {
+      break;
+    }
+  }
+  for (int n = 0; n != N; ++n) {
+    k[n] = static_cast<int>(count[n]);
+  }
+}
+
+// escape-time kernel for the n points c[0], ..., c[n - 1], interleaving them
+// eight at a time
+template<typename T>
+void mandelbrot(Complex<T> const* c, int* k, int n, int max_iter = 256,
+                double bailout_norm2 = 2.)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    mandelbrot_interleaved<8>(c + i, k + i, max_iter, bailout_norm2);
+  }
+  for (; i != n; ++i) {
+    k[i] = mandelbrot(c[i], max_iter, bailout_norm2);
+  }
+}
+
+struct Rgb
+{
+  std::uint8_t r;
+  std::uint8_t g;
+  std::uint8_t b;
+};
+
+inline bool operator==(Rgb const& c1, Rgb const& c2)
+{
+  return c1.r == c2.r && c1.g == c2.g && c1.b == c2.b;
+}
+
+inline bool operator!=(Rgb const& c1, Rgb const& c2)
+{
+  return !(c1 == c2);
+}
+
+inline Rgb to_rgb(int k, int max_iter = 256)
+{
+  return k < max_iter ? Rgb{static_cast<std::uint8_t>(10 * k), 0, 0}
+                      : Rgb{0, 0, 0};
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "doctest.h"
+#include "mandelbrot.hpp"
+
+#include <vector>
+
+TEST_CASE("Testing escape-time kernels")
+{
+  // compare the interleaved kernels with the one-point one on a grid covering
+  // the set and its surroundings
+  auto same = [](auto t, int n, int max_iter, double bailout_norm2) {
+    using T = decltype(t);
+    std::vector<Complex<T>> points;
+    for (int row = 0; row != 200; ++row) {
+      for (int column = 0; column != 200; ++column) {
+        points.emplace_back(T(-2.5 + 0.0175 * column), T(-1.75 + 0.0175 * row));
+      }
+    }
+    points.resize(n);
+    std::vector<int> k(n);
+    mandelbrot(points.data(), k.data(), n, max_iter, bailout_norm2);
+    for (int i = 0; i != n; ++i) {
+      if (k[i] != mandelbrot(points[i], max_iter, bailout_norm2)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  CHECK(same(0., 40'000, 256, 2.));
+  CHECK(same(0.f, 40'000, 256, 2.));
+  CHECK(same(0., 40'000, 1000, 4.));
+  CHECK(same(0.f, 40'000, 61, 4.));
+  CHECK(same(0.f, 40'000, 100, 2.1));
+  CHECK(same(0., 40'000, 3, 2.));
+  CHECK(same(0., 40'000, 0, 2.));
+  // fewer points than a block, and a partial last block
+  CHECK(same(0., 5, 256, 2.));
+  CHECK(same(0., 39'997, 256, 2.));
+}
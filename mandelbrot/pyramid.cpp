@@ -0,0 +1,119 @@
+#include "pyramid.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+Tile render_tile(PyramidOptions const& o, TileId id)
+{
+  using complex = Complex<double>;
+  auto const n_tiles = 1u << id.z;
+  auto const diff    = o.lower_right - o.top_left;
+  auto const delta_x = diff.real() / (n_tiles * tile_size);
+  auto const delta_y = diff.imag() / (n_tiles * tile_size);
+  auto const first_column = id.x * tile_size;
+  auto const first_row    = id.y * tile_size;
+
+  Tile tile(tile_size * tile_size);
+  std::vector<complex> points(tile_size);
+  std::vector<int> k(tile_size);
+  for (auto row = 0u; row != tile_size; ++row) {
+    for (auto column = 0u; column != tile_size; ++column) {
+      points[column] = o.top_left
+                     + complex{delta_x * (first_column + column),
+                               delta_y * (first_row + row)};
+    }
+    mandelbrot(points.data(), k.data(), static_cast<int>(tile_size));
+    for (auto column = 0u; column != tile_size; ++column) {
+      tile[row * tile_size + column] = to_rgb(k[column]);
+    }
+  }
+  return tile;
+}
+
+Tile downsample(Tile const& top_left, Tile const& top_right,
+                Tile const& bottom_left, Tile const& bottom_right)
+{
+  auto constexpr half = tile_size / 2;
+  Tile tile(tile_size * tile_size);
+  for (auto row = 0u; row != tile_size; ++row) {
+    for (auto column = 0u; column != tile_size; ++column) {
+      auto const& child = row < half ? (column < half ? top_left : top_right)
+                                     : (column < half ? bottom_left
+                                                      : bottom_right);
+      auto const r = 2 * (row % half);
+      auto const c = 2 * (column % half);
+      Rgb const* px[] = {&child[r * tile_size + c],
+                         &child[r * tile_size + c + 1],
+                         &child[(r + 1) * tile_size + c],
+                         &child[(r + 1) * tile_size + c + 1]};
+      auto average = [&](std::uint8_t Rgb::*channel) {
+        return static_cast<std::uint8_t>((px[0]->*channel + px[1]->*channel
+                                          + px[2]->*channel + px[3]->*channel
+                                          + 2)
+                                         / 4);
+      };
+      tile[row * tile_size + column] =
+          Rgb{average(&Rgb::r), average(&Rgb::g), average(&Rgb::b)};
+    }
+  }
+  return tile;
+}
+
+void build_pyramid(PyramidOptions const& o,
+                   std::function<void(TileId, Tile const&)> const& save,
+                   std::function<Tile(TileId)> const& load)
+{
+  auto const n_threads =
+      o.n_threads != 0 ? o.n_threads
+                       : std::max(1u, std::thread::hardware_concurrency());
+
+  for (auto z = static_cast<int>(o.max_zoom); z >= 0; --z) {
+    auto const n_tiles = 1u << z;
+    auto const level_size = std::uint64_t{n_tiles} * n_tiles;
+    bool const derived = o.downsample && z != static_cast<int>(o.max_zoom);
+    std::atomic<std::uint64_t> next{0};
+    std::mutex mutex;
+    std::exception_ptr error;
+
+    // every tile is a function of its coordinates only, so the result does
+    // not depend on which thread computes it
+    auto work = [&] {
+      try {
+        for (auto i = next++; i < level_size; i = next++) {
+          TileId const id{static_cast<unsigned>(z),
+                          static_cast<unsigned>(i % n_tiles),
+                          static_cast<unsigned>(i / n_tiles)};
+          if (derived) {
+            auto const child = [&](unsigned dx, unsigned dy) {
+              return load({id.z + 1, 2 * id.x + dx, 2 * id.y + dy});
+            };
+            save(id, downsample(child(0, 0), child(1, 0), child(0, 1),
+                                child(1, 1)));
+          } else {
+            save(id, render_tile(o, id));
+          }
+        }
+      } catch (...) {
+        std::lock_guard lock{mutex};
+        error = std::current_exception();
+        next  = level_size;
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < n_threads; ++t) {
+      threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
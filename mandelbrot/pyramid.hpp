@@ -0,0 +1,51 @@
+#ifndef PYRAMID_HPP
+#define PYRAMID_HPP
+
+#include "complex.hpp"
+#include "mandelbrot.hpp"
+
+#include <functional>
+#include <vector>
+
+constexpr unsigned tile_size = 256;
+
+// tile_size * tile_size pixels, stored row by row
+using Tile = std::vector<Rgb>;
+
+// XYZ tile coordinates: at zoom z the region is covered by 2^z x 2^z tiles,
+// x growing left to right and y top to bottom
+struct TileId
+{
+  unsigned z;
+  unsigned x;
+  unsigned y;
+};
+
+struct PyramidOptions
+{
+  Complex<double> top_left{-2.2, 1.5};
+  Complex<double> lower_right{0.8, -1.5};
+  unsigned max_zoom{5};
+  // derive the tiles of a level by downsampling those of the level below,
+  // instead of rendering them
+  bool downsample{true};
+  // 0 means one thread per hardware thread
+  unsigned n_threads{0};
+};
+
+Tile render_tile(PyramidOptions const& options, TileId id);
+
+// average each 2x2 block of the four tiles covering the same region at the
+// next zoom level
+Tile downsample(Tile const& top_left, Tile const& top_right,
+                Tile const& bottom_left, Tile const& bottom_right);
+
+// Produce all the tiles from max_zoom down to zoom 0, computing the tiles of
+// each level in parallel. save and load, which access the storage of the
+// tiles, are called concurrently from multiple threads; load is used only
+// when downsampling, to retrieve tiles already saved.
+void build_pyramid(PyramidOptions const& options,
+                   std::function<void(TileId, Tile const&)> const& save,
+                   std::function<Tile(TileId)> const& load);
+
+#endif
@@ -0,0 +1,78 @@
+#include "doctest.h"
+#include "pyramid.hpp"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+// tiles kept in memory, indexed by (z, x, y)
+struct Store
+{
+  std::map<std::tuple<unsigned, unsigned, unsigned>, Tile> tiles;
+  std::mutex mutex;
+
+  auto pyramid(PyramidOptions const& options)
+  {
+    build_pyramid(
+        options,
+        [&](TileId id, Tile const& tile) {
+          std::lock_guard lock{mutex};
+          tiles[{id.z, id.x, id.y}] = tile;
+        },
+        [&](TileId id) {
+          std::lock_guard lock{mutex};
+          return tiles.at({id.z, id.x, id.y});
+        });
+    return tiles;
+  }
+};
+
+}  // namespace
+
+TEST_CASE("Testing tile pyramid")
+{
+  PyramidOptions options;
+  options.max_zoom  = 2;
+  options.n_threads = 1;
+
+  Store serial;
+  auto const tiles = serial.pyramid(options);
+  CHECK(tiles.size() == 1 + 4 + 16);
+  CHECK(tiles.at({2, 3, 1}) == render_tile(options, {2, 3, 1}));
+  CHECK(tiles.at({1, 0, 1})
+        == downsample(tiles.at({2, 0, 2}), tiles.at({2, 1, 2}),
+                      tiles.at({2, 0, 3}), tiles.at({2, 1, 3})));
+
+  SUBCASE("parallel build is deterministic")
+  {
+    options.n_threads = 4;
+    Store parallel;
+    CHECK(parallel.pyramid(options) == tiles);
+  }
+
+  SUBCASE("levels rendered directly")
+  {
+    options.downsample = false;
+    Store rendered;
+    CHECK(rendered.pyramid(options).at({0, 0, 0})
+          == render_tile(options, {0, 0, 0}));
+  }
+
+  SUBCASE("downsampling averages 2x2 blocks")
+  {
+    Tile const black(tile_size * tile_size, Rgb{0, 0, 0});
+    Tile const white(tile_size * tile_size, Rgb{255, 255, 255});
+    auto const tile = downsample(black, white, white, white);
+    CHECK(tile[0] == Rgb{0, 0, 0});
+    CHECK(tile[tile_size - 1] == Rgb{255, 255, 255});
+    CHECK(tile[tile_size * tile_size - 1] == Rgb{255, 255, 255});
+
+    Tile stripes(tile_size * tile_size, Rgb{0, 0, 0});
+    for (auto i = 0u; i < stripes.size(); i += 2) {
+      stripes[i] = Rgb{100, 50, 3};
+    }
+    CHECK(downsample(stripes, stripes, stripes, stripes)[0] == Rgb{50, 25, 2});
+  }
+}
@@ -0,0 +1,145 @@
+#include "stream.hpp"
+
+#include "mandelbrot.hpp"
+#include "tiff.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using complex = Complex<double>;
+
+std::vector<std::uint8_t> render_band(StreamOptions const& o, unsigned band)
+{
+  auto const diff    = o.lower_right - o.top_left;
+  auto const delta_x = diff.real() / o.width;
+  auto const delta_y = diff.imag() / o.height;
+
+  auto const first_row = band * o.band_height;
+  auto const last_row  = std::min(first_row + o.band_height, o.height);
+  std::vector<complex> points(o.width);
+  std::vector<int> k(o.width);
+  std::vector<std::uint8_t> pixels(3 * o.width);
+  std::vector<std::uint8_t> compressed;
+  for (auto row = first_row; row != last_row; ++row) {
+    for (auto column = 0u; column != o.width; ++column) {
+      points[column] = o.top_left + complex{delta_x * column, delta_y * row};
+    }
+    mandelbrot(points.data(), k.data(), static_cast<int>(o.width));
+    for (auto column = 0u; column != o.width; ++column) {
+      auto const rgb = to_rgb(k[column]);
+      pixels[3 * column]     = rgb.r;
+      pixels[3 * column + 1] = rgb.g;
+      pixels[3 * column + 2] = rgb.b;
+    }
+    // TIFF requires each row to be compressed separately
+    packbits(pixels.data(), pixels.size(), compressed);
+  }
+  return compressed;
+}
+
+}  // namespace
+
+void render_to_tiff(std::string const& path, StreamOptions const& o)
+{
+  TiffWriter writer(path, o.width, o.height, o.band_height);
+  auto const n_bands = writer.n_strips();
+  auto const n_threads =
+      o.n_threads != 0 ? o.n_threads
+                       : std::max(1u, std::thread::hardware_concurrency());
+  // bands rendered but not yet written, plus those being rendered
+  auto const window = 2 * n_threads;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::map<unsigned, std::vector<std::uint8_t>> reorder;
+  unsigned next_band    = 0;
+  unsigned next_written = 0;
+  bool failed           = false;
+  // the first exception thrown by a worker or by the writer
+  std::exception_ptr error;
+
+  auto fail = [&](std::unique_lock<std::mutex>& lock) {
+    if (!lock.owns_lock()) {
+      lock.lock();
+    }
+    if (!error) {
+      error = std::current_exception();
+    }
+    failed = true;
+    cv.notify_all();
+  };
+
+  auto work = [&] {
+    std::unique_lock lock{mutex};
+    try {
+      while (true) {
+        cv.wait(lock, [&] {
+          return failed || next_band == n_bands
+              || next_band < next_written + window;
+        });
+        if (failed || next_band == n_bands) {
+          return;
+        }
+        auto const band = next_band++;
+        lock.unlock();
+        auto compressed = render_band(o, band);
+        lock.lock();
+        reorder.emplace(band, std::move(compressed));
+        cv.notify_all();
+      }
+    } catch (...) {
+      fail(lock);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t != n_threads; ++t) {
+    threads.emplace_back(work);
+  }
+
+  // the calling thread writes the bands in order, as soon as they are ready,
+  // and stops as soon as a worker fails
+  std::unique_lock lock{mutex, std::defer_lock};
+  try {
+    unsigned band = 0;
+    for (; band != n_bands; ++band) {
+      std::vector<std::uint8_t> compressed;
+      lock.lock();
+      cv.wait(lock, [&] { return failed || reorder.count(band) != 0; });
+      if (failed) {
+        break;
+      }
+      compressed = std::move(reorder[band]);
+      reorder.erase(band);
+      lock.unlock();
+      writer.write_strip(compressed);
+      lock.lock();
+      ++next_written;
+      lock.unlock();
+      cv.notify_all();
+    }
+    if (band == n_bands) {
+      writer.close();
+    }
+  } catch (...) {
+    fail(lock);
+  }
+  if (lock.owns_lock()) {
+    lock.unlock();
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include "complex.hpp"
+
+#include <string>
+
+struct StreamOptions
+{
+  Complex<double> top_left{-2.2, 1.5};
+  Complex<double> lower_right{0.8, -1.5};
+  unsigned width{600};
+  unsigned height{600};
+  // rows rendered and compressed together, stored as one strip of the image
+  unsigned band_height{16};
+  // 0 means one thread per hardware thread
+  unsigned n_threads{0};
+};
+
+// Render the Mandelbrot set into a strip-based TIFF image, without ever
+// holding the whole image in memory. Bands of rows are rendered and
+// compressed in parallel and written in order; a band is started only if it
+// is close enough to the next one to be written, so that at most two bands
+// per thread are in memory at any time.
+void render_to_tiff(std::string const& path, StreamOptions const& options);
+
+#endif
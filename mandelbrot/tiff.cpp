@@ -0,0 +1,202 @@
+#include "tiff.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// the header is followed by the strips; it is 8 bytes long for a classic TIFF
+// and 16 bytes long for a BigTIFF, which is known only at the end
+constexpr std::uint64_t header_size = 16;
+
+enum Type : std::uint16_t
+{
+  Short    = 3,
+  Long     = 4,
+  Rational = 5,
+  Long8    = 16
+};
+
+struct Entry
+{
+  std::uint16_t tag;
+  Type type;
+  std::uint64_t count;
+  std::vector<std::uint8_t> value;
+};
+
+template<typename T>
+void append(std::vector<std::uint8_t>& bytes, T value)
+{
+  // TIFF files written here are little-endian
+  for (unsigned i = 0; i != sizeof(T); ++i) {
+    bytes.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+  }
+}
+
+template<typename T>
+Entry make_entry(std::uint16_t tag, Type type, std::vector<T> const& values)
+{
+  Entry e{tag, type, values.size(), {}};
+  for (auto v : values) {
+    append(e.value, v);
+  }
+  return e;
+}
+
+}  // namespace
+
+void packbits(std::uint8_t const* data, std::size_t n,
+              std::vector<std::uint8_t>& out)
+{
+  std::size_t i = 0;
+  while (i != n) {
+    // length of the run of equal bytes starting at i
+    std::size_t run = 1;
+    while (i + run != n && run != 128 && data[i + run] == data[i]) {
+      ++run;
+    }
+    if (run > 1) {
+      out.push_back(static_cast<std::uint8_t>(1 - static_cast<int>(run)));
+      out.push_back(data[i]);
+      i += run;
+      continue;
+    }
+    // literal bytes, up to the next run of at least two equal bytes
+    std::size_t literal = 1;
+    while (i + literal != n && literal != 128
+           && !(i + literal + 1 != n
+                && data[i + literal] == data[i + literal + 1])) {
+      ++literal;
+    }
+    out.push_back(static_cast<std::uint8_t>(literal - 1));
+    out.insert(out.end(), data + i, data + i + literal);
+    i += literal;
+  }
+}
+
+TiffWriter::TiffWriter(std::string const& path, std::uint32_t width,
+                       std::uint32_t height, std::uint32_t rows_per_strip)
+    : out_(path, std::ios::binary | std::ios::trunc)
+    , width_{width}
+    , height_{height}
+    , rows_per_strip_{rows_per_strip}
+{
+  if (width == 0 || height == 0 || rows_per_strip == 0) {
+    throw std::runtime_error("Empty TIFF image requested");
+  }
+  if (!out_) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  out_.seekp(header_size);
+}
+
+void TiffWriter::write_strip(std::vector<std::uint8_t> const& compressed)
+{
+  if (strip_offsets_.size() == n_strips()) {
+    throw std::runtime_error("Too many TIFF strips");
+  }
+  strip_offsets_.push_back(out_.tellp());
+  strip_byte_counts_.push_back(compressed.size());
+  out_.write(reinterpret_cast<char const*>(compressed.data()),
+             compressed.size());
+  if (!out_) {
+    throw std::runtime_error("Cannot write TIFF strip");
+  }
+}
+
+void TiffWriter::close()
+{
+  if (strip_offsets_.size() != n_strips()) {
+    throw std::runtime_error("Missing TIFF strips");
+  }
+
+  std::uint64_t const end = out_.tellp();
+  // strip offsets and byte counts are stored in the directory too, so leave
+  // a generous margin for it
+  bool const big = end + 16 * strip_offsets_.size() + 1024
+                 > std::numeric_limits<std::uint32_t>::max();
+
+  std::vector<Entry> entries;
+  entries.push_back(make_entry<std::uint32_t>(256, Long, {width_}));
+  entries.push_back(make_entry<std::uint32_t>(257, Long, {height_}));
+  entries.push_back(make_entry<std::uint16_t>(258, Short, {8, 8, 8}));
+  // PackBits compression
+  entries.push_back(make_entry<std::uint16_t>(259, Short, {32773}));
+  // RGB
+  entries.push_back(make_entry<std::uint16_t>(262, Short, {2}));
+  if (big) {
+    entries.push_back(make_entry(273, Long8, strip_offsets_));
+  } else {
+    entries.push_back(make_entry(
+        273, Long, std::vector<std::uint32_t>(strip_offsets_.begin(),
+                                              strip_offsets_.end())));
+  }
+  entries.push_back(make_entry<std::uint16_t>(277, Short, {3}));
+  entries.push_back(make_entry<std::uint32_t>(278, Long, {rows_per_strip_}));
+  if (big) {
+    entries.push_back(make_entry(279, Long8, strip_byte_counts_));
+  } else {
+    entries.push_back(make_entry(
+        279, Long, std::vector<std::uint32_t>(strip_byte_counts_.begin(),
+                                              strip_byte_counts_.end())));
+  }
+  // 72 pixels per inch
+  entries.push_back(make_entry<std::uint32_t>(282, Rational, {72, 1}));
+  entries.push_back(make_entry<std::uint32_t>(283, Rational, {72, 1}));
+  entries.push_back(make_entry<std::uint16_t>(296, Short, {2}));
+
+  // the values that don't fit into their entry are written before the
+  // directory, at word-aligned offsets
+  std::size_t const inline_size = big ? 8 : 4;
+  std::vector<std::uint8_t> data;
+  std::vector<std::uint8_t> directory;
+  if (end % 2 != 0) {
+    data.push_back(0);
+  }
+  big ? append<std::uint64_t>(directory, entries.size())
+      : append<std::uint16_t>(directory, entries.size());
+  for (auto& e : entries) {
+    append<std::uint16_t>(directory, e.tag);
+    append<std::uint16_t>(directory, e.type);
+    big ? append<std::uint64_t>(directory, e.count)
+        : append<std::uint32_t>(directory, e.count);
+    if (e.value.size() <= inline_size) {
+      e.value.resize(inline_size);
+      directory.insert(directory.end(), e.value.begin(), e.value.end());
+    } else {
+      auto const offset = end + data.size();
+      big ? append<std::uint64_t>(directory, offset)
+          : append<std::uint32_t>(directory, offset);
+      data.insert(data.end(), e.value.begin(), e.value.end());
+      if (data.size() % 2 != 0) {
+        data.push_back(0);
+      }
+    }
+  }
+  // no further directories
+  big ? append<std::uint64_t>(directory, 0)
+      : append<std::uint32_t>(directory, 0);
+  auto const directory_offset = end + data.size();
+
+  std::vector<std::uint8_t> header{'I', 'I'};
+  if (big) {
+    append<std::uint16_t>(header, 43);
+    append<std::uint16_t>(header, 8);
+    append<std::uint16_t>(header, 0);
+    append<std::uint64_t>(header, directory_offset);
+  } else {
+    append<std::uint16_t>(header, 42);
+    append<std::uint32_t>(header, directory_offset);
+  }
+
+  out_.write(reinterpret_cast<char const*>(data.data()), data.size());
+  out_.write(reinterpret_cast<char const*>(directory.data()),
+             directory.size());
+  out_.seekp(0);
+  out_.write(reinterpret_cast<char const*>(header.data()), header.size());
+  out_.close();
+  if (!out_) {
+    throw std::runtime_error("Cannot write TIFF directory");
+  }
+}
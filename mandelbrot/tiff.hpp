@@ -0,0 +1,41 @@
+#ifndef TIFF_HPP
+#define TIFF_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Append the PackBits encoding of n bytes to out
+void packbits(std::uint8_t const* data, std::size_t n,
+              std::vector<std::uint8_t>& out);
+
+// Writer of an 8-bit RGB TIFF image stored in PackBits-compressed strips of
+// rows_per_strip rows, which must be written in order. Strips are written as
+// soon as they are available and the directory describing them is written by
+// close(); if the file exceeds 4 GB it is written as a BigTIFF.
+class TiffWriter
+{
+  std::ofstream out_;
+  std::uint32_t width_;
+  std::uint32_t height_;
+  std::uint32_t rows_per_strip_;
+  std::vector<std::uint64_t> strip_offsets_;
+  std::vector<std::uint64_t> strip_byte_counts_;
+
+ public:
+  TiffWriter(std::string const& path, std::uint32_t width,
+             std::uint32_t height, std::uint32_t rows_per_strip);
+
+  std::uint32_t n_strips() const
+  {
+    return (height_ + rows_per_strip_ - 1) / rows_per_strip_;
+  }
+
+  // append a strip, already compressed row by row with packbits
+  void write_strip(std::vector<std::uint8_t> const& compressed);
+
+  void close();
+};
+
+#endif
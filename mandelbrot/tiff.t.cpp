@@ -0,0 +1,120 @@
+#include "doctest.h"
+#include "mandelbrot.hpp"
+#include "stream.hpp"
+#include "tiff.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+namespace {
+
+std::vector<std::uint8_t> unpackbits(std::uint8_t const* data, std::size_t n)
+{
+  std::vector<std::uint8_t> out;
+  for (std::size_t i = 0; i < n;) {
+    auto const header = static_cast<std::int8_t>(data[i++]);
+    if (header >= 0) {
+      out.insert(out.end(), data + i, data + i + header + 1);
+      i += header + 1;
+    } else if (header != -128) {
+      out.insert(out.end(), 1 - header, data[i++]);
+    }
+  }
+  return out;
+}
+
+template<typename T>
+T read(std::vector<std::uint8_t> const& bytes, std::size_t offset)
+{
+  T value = 0;
+  for (unsigned i = 0; i != sizeof(T); ++i) {
+    value |= static_cast<T>(bytes[offset + i]) << (8 * i);
+  }
+  return value;
+}
+
+// minimal reader of the classic TIFF files written by TiffWriter, returning
+// the decompressed pixels
+std::vector<std::uint8_t> read_tiff(std::string const& path, unsigned& width,
+                                    unsigned& height)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::vector<std::uint8_t> const bytes{std::istreambuf_iterator<char>{in},
+                                        std::istreambuf_iterator<char>{}};
+  REQUIRE(read<std::uint16_t>(bytes, 2) == 42);
+  auto const directory = read<std::uint32_t>(bytes, 4);
+  auto const n_entries = read<std::uint16_t>(bytes, directory);
+  std::map<int, std::vector<std::uint32_t>> tags;
+  for (int e = 0; e != n_entries; ++e) {
+    auto const entry = directory + 2 + 12 * e;
+    auto const tag   = read<std::uint16_t>(bytes, entry);
+    auto const type  = read<std::uint16_t>(bytes, entry + 2);
+    auto const count = read<std::uint32_t>(bytes, entry + 4);
+    auto const size  = type == 3 ? 2u : 4u;
+    auto const values =
+        count * size <= 4 ? entry + 8 : read<std::uint32_t>(bytes, entry + 8);
+    for (std::uint32_t i = 0; i != count; ++i) {
+      tags[tag].push_back(size == 2
+                              ? read<std::uint16_t>(bytes, values + 2 * i)
+                              : read<std::uint32_t>(bytes, values + 4 * i));
+    }
+  }
+  width  = tags[256][0];
+  height = tags[257][0];
+  CHECK(tags[259][0] == 32773);
+  std::vector<std::uint8_t> pixels;
+  for (std::size_t s = 0; s != tags[273].size(); ++s) {
+    auto const strip = unpackbits(&bytes[tags[273][s]], tags[279][s]);
+    pixels.insert(pixels.end(), strip.begin(), strip.end());
+  }
+  return pixels;
+}
+
+}  // namespace
+
+TEST_CASE("Testing PackBits")
+{
+  std::vector<std::uint8_t> data{1, 2, 3, 3, 3, 3, 4, 5, 5};
+  data.insert(data.end(), 300, 7);
+  for (int i = 0; i != 200; ++i) {
+    data.push_back(static_cast<std::uint8_t>(i));
+  }
+  std::vector<std::uint8_t> compressed;
+  packbits(data.data(), data.size(), compressed);
+  CHECK(compressed.size() < data.size());
+  CHECK(unpackbits(compressed.data(), compressed.size()) == data);
+}
+
+TEST_CASE("Testing streaming render")
+{
+  StreamOptions options;
+  options.width       = 50;
+  options.height      = 37;
+  options.band_height = 4;
+  options.n_threads   = 3;
+  render_to_tiff("stream.t.tif", options);
+
+  unsigned width  = 0;
+  unsigned height = 0;
+  auto const pixels = read_tiff("stream.t.tif", width, height);
+  std::remove("stream.t.tif");
+  CHECK(width == 50);
+  CHECK(height == 37);
+  REQUIRE(pixels.size() == 3 * 50 * 37);
+
+  auto const diff    = options.lower_right - options.top_left;
+  auto const delta_x = diff.real() / width;
+  auto const delta_y = diff.imag() / height;
+  bool same          = true;
+  for (auto row = 0u; row != height; ++row) {
+    for (auto column = 0u; column != width; ++column) {
+      auto const rgb = to_rgb(mandelbrot(
+          options.top_left + Complex<double>{delta_x * column, delta_y * row}));
+      auto const p = &pixels[3 * (row * width + column)];
+      same = same && p[0] == rgb.r && p[1] == rgb.g && p[2] == rgb.b;
+    }
+  }
+  CHECK(same);
+}
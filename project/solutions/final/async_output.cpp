@@ -0,0 +1,210 @@
+#include "async_output.hpp"
+
+#include <stdexcept>
+
+// A thread about to sleep sets its waiting flag and then checks the rings; a
+// thread filling or emptying a slot commits or releases it and then checks
+// the flag of the other one. The fences keep both stores before both loads,
+// so at least one of the two threads sees the store of the other: either the
+// sleeper sees the slot, or the other thread sees the flag and wakes it,
+// under the mutex the sleeper waits with.
+
+AsyncOutput::AsyncOutput(OutputFiles const& files, int size,
+                         SnapshotPolicy policy, int snapshot_slots)
+    : size_{size},
+      policy_{policy},
+      stats_(1024),
+      snapshots_(snapshot_slots > 0 ? std::size_t(snapshot_slots) : 0)
+{
+  if (!files.csv.empty()) {
+    csv_.open(files.csv);
+    if (!csv_) {
+      throw std::runtime_error("Cannot open " + files.csv);
+    }
+    csv_ << "Solar luminosity, Global temperature, Black daisies, White "
+            "daisies, Barren lands\n";
+  }
+  if (!files.stats.empty()) {
+    stats_writer_.emplace(files.stats);
+  }
+  if (!files.snapshots.empty()) {
+    snapshot_writer_.emplace(files.snapshots, size);
+  }
+  writer_ = std::thread([this] { write(); });
+}
+
+AsyncOutput::~AsyncOutput()
+{
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void AsyncOutput::wake_writer()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writer_waiting_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    wake_writer_.notify_one();
+  }
+}
+
+template<typename T>
+T* AsyncOutput::wait_for_slot(SpscRing<T>& ring)
+{
+  T* slot{nullptr};
+  std::unique_lock<std::mutex> lock{mutex_};
+  producer_waiting_.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  wake_producer_.wait(lock, [&] {
+    slot = ring.write_slot();
+    return slot != nullptr || failed_.load(std::memory_order_acquire);
+  });
+  producer_waiting_.store(false, std::memory_order_relaxed);
+  lock.unlock();
+  if (slot == nullptr) {
+    close();
+  }
+  return slot;
+}
+
+void AsyncOutput::check_open()
+{
+  if (failed_.load(std::memory_order_acquire)) {
+    close();
+  }
+  if (!writer_.joinable()) {
+    throw std::runtime_error("Output already closed");
+  }
+}
+
+void AsyncOutput::publish(Stats const& stats)
+{
+  check_open();
+  Stats* slot = stats_.write_slot();
+  if (slot == nullptr) {
+    slot = wait_for_slot(stats_);
+  }
+  *slot = stats;
+  stats_.commit();
+  wake_writer();
+}
+
+bool AsyncOutput::publish(std::uint64_t step, World const& world)
+{
+  if (world.size() != size_) {
+    throw std::runtime_error("Snapshot of a world of a different size");
+  }
+  check_open();
+  Snapshot* slot = snapshots_.write_slot();
+  if (slot == nullptr) {
+    if (policy_ == SnapshotPolicy::Drop) {
+      ++dropped_;
+      return false;
+    }
+    slot = wait_for_slot(snapshots_);
+  }
+  // the slots keep their buffers, so copying doesn't allocate
+  slot->step = step;
+  slot->temperatures.assign(world.temperatures().begin(),
+                            world.temperatures().end());
+  slot->daisies.assign(world.daisies().begin(), world.daisies().end());
+  slot->ages.assign(world.ages().begin(), world.ages().end());
+  snapshots_.commit();
+  wake_writer();
+  return true;
+}
+
+bool AsyncOutput::drain()
+{
+  bool any{false};
+  while (Stats const* stats = stats_.read_slot()) {
+    if (csv_.is_open()) {
+      write_csv(*stats, csv_);
+    }
+    if (stats_writer_) {
+      stats_writer_->write(*stats);
+    }
+    stats_.release();
+    any = true;
+  }
+  if (Snapshot const* snapshot = snapshots_.read_slot()) {
+    if (snapshot_writer_) {
+      snapshot_writer_->write(*snapshot);
+    }
+    snapshots_.release();
+    any = true;
+  }
+  if (any) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producer_waiting_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      wake_producer_.notify_one();
+    }
+  }
+  return any;
+}
+
+void AsyncOutput::flush()
+{
+  if (csv_.is_open() && !csv_.flush()) {
+    throw std::runtime_error("Cannot write the stats");
+  }
+  if (stats_writer_) {
+    stats_writer_->flush();
+  }
+  if (snapshot_writer_) {
+    snapshot_writer_->flush();
+  }
+}
+
+void AsyncOutput::write()
+{
+  try {
+    while (true) {
+      // read before draining, so that everything published before closing
+      // is written
+      bool const closing = closing_.load(std::memory_order_acquire);
+      if (drain()) {
+        continue;
+      }
+      if (closing) {
+        break;
+      }
+      // nothing to do: flush, so that the files are up to date while the
+      // simulation runs, and sleep until something is published
+      flush();
+      std::unique_lock<std::mutex> lock{mutex_};
+      writer_waiting_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      wake_writer_.wait(lock, [&] {
+        return closing_.load(std::memory_order_acquire) ||
+               stats_.read_slot() != nullptr ||
+               snapshots_.read_slot() != nullptr;
+      });
+      writer_waiting_.store(false, std::memory_order_relaxed);
+    }
+    flush();
+  } catch (...) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    error_ = std::current_exception();
+    failed_.store(true, std::memory_order_release);
+    wake_producer_.notify_one();
+  }
+}
+
+void AsyncOutput::close()
+{
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      closing_.store(true, std::memory_order_release);
+      wake_writer_.notify_one();
+    }
+    writer_.join();
+  }
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
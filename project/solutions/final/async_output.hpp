@@ -0,0 +1,107 @@
+#if !defined(ASYNC_OUTPUT_H)
+#define ASYNC_OUTPUT_H
+
+#include "output.hpp"
+#include "spsc_ring.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// the files written by an AsyncOutput; an empty path is not written
+struct OutputFiles
+{
+  // the stats as CSV, as data.csv
+  std::string csv;
+  // the stats as a binary stats file
+  std::string stats;
+  // the snapshots as a binary snapshot file
+  std::string snapshots;
+};
+
+// what publishing a snapshot does when all the snapshot slots are still
+// waiting to be written
+enum class SnapshotPolicy { Block, Drop };
+
+// Output written by a thread of its own. The simulation publishes stats and
+// snapshots into rings of slots shared with the writer thread, without
+// locking; the writer thread formats, compresses and writes them. Stats are
+// never dropped: their ring is large, and publishing waits for a free slot if
+// it is full. Snapshots are large, so there are only a few slots, and
+// publishing waits for one or drops the snapshot, as chosen by the policy.
+class AsyncOutput
+{
+  std::ofstream csv_;
+  std::optional<StatsWriter> stats_writer_;
+  std::optional<SnapshotWriter> snapshot_writer_;
+  int size_;
+  SnapshotPolicy policy_;
+  std::uint64_t dropped_{0};
+  SpscRing<Stats> stats_;
+  SpscRing<Snapshot> snapshots_;
+  // set by each thread before sleeping, so that the other one wakes it only
+  // if it may be sleeping
+  std::atomic<bool> writer_waiting_{false};
+  std::atomic<bool> producer_waiting_{false};
+  std::atomic<bool> closing_{false};
+  std::atomic<bool> failed_{false};
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable wake_writer_;
+  std::condition_variable wake_producer_;
+  std::thread writer_;
+
+  // the body of the writer thread
+  void write();
+
+  // write the published records; false if there were none
+  bool drain();
+
+  void flush();
+
+  // throws if the writer failed or was stopped
+  void check_open();
+
+  void wake_writer();
+
+  // wait for a free slot of the ring; throws if the writer failed
+  template<typename T>
+  T* wait_for_slot(SpscRing<T>& ring);
+
+ public:
+  // the files are opened here, so that failing to open them throws;
+  // snapshot_slots must be a power of two
+  AsyncOutput(OutputFiles const& files, int size,
+              SnapshotPolicy policy = SnapshotPolicy::Block,
+              int snapshot_slots = 2);
+
+  AsyncOutput(AsyncOutput const&) = delete;
+
+  AsyncOutput& operator=(AsyncOutput const&) = delete;
+
+  // closes, ignoring the errors of the writer
+  ~AsyncOutput();
+
+  void publish(Stats const& stats);
+
+  // copy the state of the world into a snapshot slot; false if the snapshot
+  // was dropped
+  bool publish(std::uint64_t step, World const& world);
+
+  std::uint64_t dropped_snapshots() const
+  {
+    return dropped_;
+  }
+
+  // wait for everything published to be written and stop the writer thread;
+  // rethrows its error, if it failed, here and by any later publish
+  void close();
+};
+
+#endif  // ASYNC_OUTPUT_H
@@ -0,0 +1,383 @@
+#include "batch.hpp"
+
+#include "philox.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The kernels below work on the worlds [first, k) of a patch, the worlds
+// being the elements of the arrays. The vectorized ones compute the same as
+// the scalar ones, operation by operation.
+
+// the new temperatures of a patch with n neighbors, whose heated
+// temperatures start at heated + neighbors[i]; the sum of the neighbors
+// starts from the first one, as in the interior kernels of diffuse_row, or
+// from 0, as on the borders
+void diffuse_worlds(double const* heated, int const* neighbors, int n,
+                    bool from_first, double const* mid, double* out, int first,
+                    int k, double keep, double rate)
+{
+  for (int w{first}; w < k; ++w) {
+    double sum = from_first ? heated[neighbors[0] + w] : 0.;
+    for (int i{from_first}; i < n; ++i) {
+      sum += heated[neighbors[i] + w];
+    }
+    out[w] = mid[w] * keep + sum * rate;
+  }
+}
+
+// The loops below have no branches on the state of a world, the choices
+// being selects, so that they vectorize across the worlds.
+
+// the heated temperatures of a patch, with the heating of world w for daisy
+// d at heating[d * k + w]
+void heat_worlds(double const* t, Daisy const* d, double const* heating,
+                 double* heated, int k)
+{
+  for (int w{0}; w < k; ++w) {
+    double const black = heating[w];
+    double const white = heating[k + w];
+    double const barren = heating[2 * k + w];
+    double const h = d[w] == Daisy::Black   ? black
+                     : d[w] == Daisy::White ? white
+                                            : barren;
+    heated[w] = (t[w] + h) * 0.5;
+  }
+}
+
+// as World::age_and_propose on a patch, given the words drawn for it by
+// philox_draw; to_unit is computed in two exact parts, so that it needs no
+// conversion of 64-bit integers
+void propose_worlds(std::uint16_t const* age, Daisy const* daisy,
+                    double const* temperature, std::uint32_t const* words,
+                    std::uint16_t* next_age, Daisy* next_daisy,
+                    std::uint8_t* seeds, std::uint32_t* target_word,
+                    int max_age, int k)
+{
+  for (int w{0}; w < k; ++w) {
+    std::uint16_t const a = age[w] + 1;
+    Daisy const alive = daisy[w];
+    next_age[w] = a;
+    next_daisy[w] = a > max_age ? Daisy::Barren : alive;
+  }
+  for (int w{0}; w < k; ++w) {
+    double const unit =
+        (double(words[w]) * 0x1p21 + double(words[k + w] >> 11)) * 0x1p-53;
+    seeds[w] = (next_daisy[w] != Daisy::Barren) &
+               (unit < seeding_threshold(temperature[w]));
+    target_word[w] = words[2 * k + w];
+  }
+}
+
+// as World::sprout on a seeding patch, whose daisies start at self and whose
+// n neighbors start at next_daisy + neighbors[i], in the order of the bits
+// of World::barren_neighbors; the patch itself is never barren when it
+// seeds, so it isn't looked at
+void commit_worlds(int self, int const* neighbors, int n,
+                   std::uint8_t const* seeds, std::uint32_t const* target_word,
+                   Daisy* next_daisy, std::uint16_t* next_age,
+                   std::uint8_t* rank, int k)
+{
+  std::fill_n(rank, k, 0);
+  for (int i{0}; i < n; ++i) {
+    Daisy const* const d = next_daisy + neighbors[i];
+    for (int w{0}; w < k; ++w) {
+      rank[w] += d[w] == Daisy::Barren;
+    }
+  }
+  // the rank of the chosen barren neighbor among them, as by to_index, or
+  // one that is never reached if the world doesn't seed
+  for (int w{0}; w < k; ++w) {
+    std::uint8_t const barren = rank[w];
+    std::uint8_t const chosen =
+        std::uint8_t((std::uint64_t{target_word[self + w]} * barren) >> 32);
+    rank[w] = seeds[self + w] & (barren > 0) ? chosen : 0xFF;
+  }
+  for (int i{0}; i < n; ++i) {
+    Daisy* const d = next_daisy + neighbors[i];
+    std::uint16_t* const a = next_age + neighbors[i];
+    for (int w{0}; w < k; ++w) {
+      Daisy const seed = next_daisy[self + w];
+      Daisy const old = d[w];
+      std::uint16_t const old_age = a[w];
+      bool const barren = old == Daisy::Barren;
+      bool const hit = barren & (rank[w] == 0);
+      d[w] = hit ? seed : old;
+      a[w] = hit ? 0 : old_age;
+      rank[w] -= barren;
+    }
+  }
+}
+
+#if defined(BATCH_X86)
+
+__attribute__((target("avx2"))) void diffuse_worlds_avx2(
+    double const* heated, int const* neighbors, int n, bool from_first,
+    double const* mid, double* out, int first, int k, double keep, double rate)
+{
+  auto const keep_v = _mm256_set1_pd(keep);
+  auto const rate_v = _mm256_set1_pd(rate);
+  int w{first};
+  for (; w + 4 <= k; w += 4) {
+    auto sum = from_first ? _mm256_loadu_pd(heated + neighbors[0] + w)
+                          : _mm256_setzero_pd();
+    for (int i{from_first}; i < n; ++i) {
+      sum = _mm256_add_pd(sum, _mm256_loadu_pd(heated + neighbors[i] + w));
+    }
+    auto const t = _mm256_mul_pd(_mm256_loadu_pd(mid + w), keep_v);
+    _mm256_storeu_pd(out + w, _mm256_add_pd(t, _mm256_mul_pd(sum, rate_v)));
+  }
+  diffuse_worlds(heated, neighbors, n, from_first, mid, out, w, k, keep,
+                 rate);
+}
+
+__attribute__((target("avx512f"))) void diffuse_worlds_avx512(
+    double const* heated, int const* neighbors, int n, bool from_first,
+    double const* mid, double* out, int first, int k, double keep, double rate)
+{
+  auto const keep_v = _mm512_set1_pd(keep);
+  auto const rate_v = _mm512_set1_pd(rate);
+  int w{first};
+  for (; w + 8 <= k; w += 8) {
+    auto sum = from_first ? _mm512_loadu_pd(heated + neighbors[0] + w)
+                          : _mm512_setzero_pd();
+    for (int i{from_first}; i < n; ++i) {
+      sum = _mm512_add_pd(sum, _mm512_loadu_pd(heated + neighbors[i] + w));
+    }
+    auto const t = _mm512_mul_pd(_mm512_loadu_pd(mid + w), keep_v);
+    _mm512_storeu_pd(out + w, _mm512_add_pd(t, _mm512_mul_pd(sum, rate_v)));
+  }
+  diffuse_worlds(heated, neighbors, n, from_first, mid, out, w, k, keep,
+                 rate);
+}
+
+#endif
+
+using DiffuseKernel = void (*)(double const*, int const*, int, bool,
+                               double const*, double*, int, int, double,
+                               double);
+
+DiffuseKernel diffuse_kernel(Simd simd)
+{
+#if defined(BATCH_X86)
+  switch (simd) {
+    case Simd::Avx512:
+      return diffuse_worlds_avx512;
+    case Simd::Avx2:
+      return diffuse_worlds_avx2;
+    case Simd::None:
+    default:
+      break;
+  }
+#endif
+  (void)simd;
+  return diffuse_worlds;
+}
+
+}  // namespace
+
+WorldBatch::WorldBatch(std::vector<World> const& worlds, Simd simd)
+    : n_worlds_(worlds.size()), simd_{simd}
+{
+  if (worlds.empty()) {
+    throw std::runtime_error("A batch needs at least one world");
+  }
+  size_ = worlds[0].size_;
+  max_age_ = worlds[0].max_age_;
+  int const n = size_ * size_;
+  int const k = n_worlds_;
+  temperature_.resize(std::size_t(n) * k);
+  daisy_.resize(std::size_t(n) * k);
+  age_.resize(std::size_t(n) * k);
+  for (int w{0}; w < k; ++w) {
+    auto const& world = worlds[w];
+    if (world.size_ != size_ || world.max_age_ != max_age_) {
+      throw std::runtime_error(
+          "The worlds of a batch must have the same size and maximum age");
+    }
+    for (int idx{0}; idx < n; ++idx) {
+      temperature_[idx * k + w] = world.temperature_[idx];
+      daisy_[idx * k + w] = world.daisy_[idx];
+      age_[idx * k + w] = world.age_[idx];
+    }
+    seed_.push_back(world.seed_);
+    steps_.push_back(world.steps_);
+  }
+  next_temperature_.resize(temperature_.size());
+  next_daisy_.resize(daisy_.size());
+  next_age_.resize(age_.size());
+  heated_.resize(temperature_.size());
+  seeds_.resize(daisy_.size());
+  target_word_.resize(daisy_.size());
+  heating_.resize(3 * k);
+  philox_.resize(5 * k);
+  words_.resize(3 * std::size_t(size_) * k);
+  rank_.resize(k);
+  // the neighbors of each patch within the grid, row by row
+  neighbors_.resize(std::size_t(n) * 8);
+  n_neighbors_.resize(n);
+  for (int row{0}; row < size_; ++row) {
+    for (int col{0}; col < size_; ++col) {
+      int const idx = row * size_ + col;
+      int count{0};
+      for (int r{row - 1}; r <= row + 1; ++r) {
+        for (int c{col - 1}; c <= col + 1; ++c) {
+          if (r >= 0 && r < size_ && c >= 0 && c < size_ &&
+              (r != row || c != col)) {
+            neighbors_[idx * 8 + count++] = (r * size_ + c) * k;
+          }
+        }
+      }
+      n_neighbors_[idx] = count;
+    }
+  }
+}
+
+void WorldBatch::heat()
+{
+  int const k = n_worlds_;
+  for (int idx{0}; idx < size_ * size_; ++idx) {
+    heat_worlds(temperature_.data() + idx * k, daisy_.data() + idx * k,
+                heating_.data(), heated_.data() + idx * k, k);
+  }
+}
+
+void WorldBatch::diffuse()
+{
+  // the neighbors are added in the same order as by diffuse_row, so the
+  // temperatures are the same as those of the worlds stepped alone
+  int const k = n_worlds_;
+  // with the weights of diffuse_row, at the diffusion rate of World
+  auto const weights = diffusion_weights(0.5);
+  auto const kernel = diffuse_kernel(simd_);
+  for (int idx{0}; idx < size_ * size_; ++idx) {
+    int const n = n_neighbors_[idx];
+    kernel(heated_.data(), neighbors_.data() + idx * 8, n, n == 8,
+           heated_.data() + idx * k, next_temperature_.data() + idx * k, 0, k,
+           weights.keep[n], weights.k);
+  }
+}
+
+void WorldBatch::age_and_propose()
+{
+  int const k = n_worlds_;
+  // the counters and keys of the worlds, as in World::age_and_propose
+  std::uint32_t* const idx = philox_.data();
+  std::uint32_t* const steps_low = idx + k;
+  std::uint32_t* const steps_high = steps_low + k;
+  std::uint32_t* const key0 = steps_high + k;
+  std::uint32_t* const key1 = key0 + k;
+  for (int w{0}; w < k; ++w) {
+    steps_low[w] = steps_[w];
+    steps_high[w] = steps_[w] >> 32;
+    key0[w] = seed_[w];
+    key1[w] = seed_[w] >> 32;
+  }
+  // a row is drawn before it is proposed, rather than a patch at a time,
+  // which keeps the loads of the words away from their stores
+  for (int row{0}; row < size_; ++row) {
+    for (int col{0}; col < size_; ++col) {
+      // the words are drawn for the barren patches as well, and ignored
+      std::fill_n(idx, k, row * size_ + col);
+      philox_draw(idx, steps_low, steps_high, key0, key1,
+                  words_.data() + 3 * col * k, k, simd_);
+    }
+    for (int col{0}; col < size_; ++col) {
+      int const i = (row * size_ + col) * k;
+      propose_worlds(age_.data() + i, daisy_.data() + i,
+                     next_temperature_.data() + i, words_.data() + 3 * col * k,
+                     next_age_.data() + i, next_daisy_.data() + i,
+                     seeds_.data() + i, target_word_.data() + i, max_age_, k);
+    }
+  }
+}
+
+void WorldBatch::commit_seeds()
+{
+  // in the phases of World::commit_seeds: the neighborhoods of the patches
+  // of a phase don't overlap, so each world sees its seeds committed in the
+  // same order as alone
+  int const k = n_worlds_;
+  for (int phase{0}; phase < 9; ++phase) {
+    for (int row{phase / 3}; row < size_; row += 3) {
+      for (int col{phase % 3}; col < size_; col += 3) {
+        int const idx = row * size_ + col;
+        commit_worlds(idx * k, neighbors_.data() + idx * 8, n_neighbors_[idx],
+                      seeds_.data(), target_word_.data(), next_daisy_.data(),
+                      next_age_.data(), rank_.data(), k);
+      }
+    }
+  }
+}
+
+void WorldBatch::step(double solar_luminosity)
+{
+  int const k = n_worlds_;
+  auto const table = heating_table(solar_luminosity);
+  for (int d{0}; d < 3; ++d) {
+    std::fill_n(heating_.begin() + d * k, k, table[d]);
+  }
+  step();
+}
+
+void WorldBatch::step(std::vector<double> const& luminosities)
+{
+  int const k = n_worlds_;
+  if (int(luminosities.size()) != k) {
+    throw std::runtime_error("One luminosity per world is needed");
+  }
+  for (int w{0}; w < k; ++w) {
+    auto const table = heating_table(luminosities[w]);
+    for (int d{0}; d < 3; ++d) {
+      heating_[d * k + w] = table[d];
+    }
+  }
+  step();
+}
+
+void WorldBatch::step()
+{
+  heat();
+  diffuse();
+  age_and_propose();
+  commit_seeds();
+  for (auto& steps : steps_) {
+    ++steps;
+  }
+  std::swap(temperature_, next_temperature_);
+  std::swap(daisy_, next_daisy_);
+  std::swap(age_, next_age_);
+}
+
+World WorldBatch::world(int w) const
+{
+  if (w < 0 || w >= n_worlds_) {
+    throw std::runtime_error("No such world in the batch");
+  }
+  int const k = n_worlds_;
+  int const n = size_ * size_;
+  World world(0, 0., 0., 0);
+  world.size_ = size_;
+  world.max_age_ = max_age_;
+  world.seed_ = seed_[w];
+  world.steps_ = steps_[w];
+  world.temperature_.resize(n);
+  world.daisy_.resize(n);
+  world.age_.resize(n);
+  for (int idx{0}; idx < n; ++idx) {
+    world.temperature_[idx] = temperature_[idx * k + w];
+    world.daisy_[idx] = daisy_[idx * k + w];
+    world.age_[idx] = age_[idx * k + w];
+  }
+  world.resize_buffers();
+  world.count();
+  return world;
+}
@@ -0,0 +1,84 @@
+#if !defined(BATCH_H)
+#define BATCH_H
+
+#include "diffusion.hpp"
+#include "world.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Several small worlds of the same size stepped together, for scans of many
+// tiny worlds. The state of patch i of world w is stored at i * worlds() + w,
+// so the loops over the worlds are the innermost ones and every phase of a
+// step vectorizes across the worlds, whatever the size of the grid. Each
+// world keeps its own seed and steps exactly as it would alone.
+class WorldBatch
+{
+  int size_{0};
+  int max_age_{0};
+  int n_worlds_{0};
+  std::vector<double> temperature_;
+  std::vector<Daisy> daisy_;
+  std::vector<std::uint16_t> age_;
+  std::vector<double> next_temperature_;
+  std::vector<Daisy> next_daisy_;
+  std::vector<std::uint16_t> next_age_;
+  std::vector<double> heated_;
+  // the heating of each world, for each kind of daisy
+  std::vector<double> heating_;
+  // the seed and the number of steps of each world
+  std::vector<std::uint64_t> seed_;
+  std::vector<std::uint64_t> steps_;
+  std::vector<std::uint8_t> seeds_;
+  std::vector<std::uint32_t> target_word_;
+  // the Philox counters and keys of the worlds, and the words drawn by them
+  // for a row of patches
+  std::vector<std::uint32_t> philox_;
+  std::vector<std::uint32_t> words_;
+  // scratch for the commit of the seeds, one byte per world
+  std::vector<std::uint8_t> rank_;
+  // the offsets of the state of the neighbors of each patch, 8 slots per
+  // patch, and their number
+  std::vector<int> neighbors_;
+  std::vector<std::uint8_t> n_neighbors_;
+  Simd simd_;
+
+  void heat();
+
+  void diffuse();
+
+  void age_and_propose();
+
+  void commit_seeds();
+
+  // step all the worlds, with the heating set
+  void step();
+
+ public:
+  // the worlds must have the same size and maximum age; the diffusion and
+  // the random numbers are vectorized across the worlds with simd, which
+  // doesn't change the result
+  explicit WorldBatch(std::vector<World> const& worlds,
+                      Simd simd = best_simd());
+
+  int size() const
+  {
+    return size_;
+  }
+
+  int worlds() const
+  {
+    return n_worlds_;
+  }
+
+  // step all the worlds with the same luminosity
+  void step(double solar_luminosity);
+
+  // step world w with luminosity luminosities[w]
+  void step(std::vector<double> const& luminosities);
+
+  // a copy of world w, in the state it would have if stepped alone
+  World world(int w) const;
+};
+
+#endif  // BATCH_H
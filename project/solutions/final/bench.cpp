@@ -0,0 +1,230 @@
+#include "batch.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// count the allocations, replacing the global operator new
+namespace {
+std::size_t n_allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+  ++n_allocations;
+  if (auto p = std::malloc(size != 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace {
+
+struct Measure
+{
+  double ms;
+  double allocations;
+};
+
+// milliseconds and allocations per call of f
+template<typename F>
+Measure measure(int repetitions, F f)
+{
+  f();
+  auto const allocations = n_allocations;
+  auto const start = std::chrono::steady_clock::now();
+  for (int r{0}; r < repetitions; ++r) {
+    f();
+  }
+  std::chrono::duration<double, std::milli> const elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {elapsed.count() / repetitions,
+          double(n_allocations - allocations) / repetitions};
+}
+
+void report(char const* name, int size, Measure m)
+{
+  std::printf("%-28s %6d %12.3f %12.1f\n", name, size, m.ms, m.allocations);
+}
+
+void bench_diffusion(int size, int repetitions)
+{
+  std::vector<double> temperatures(size * size);
+  for (int i{0}; i < size * size; ++i) {
+    temperatures[i] = i % 17;
+  }
+  std::vector<double> new_temperatures(size * size);
+
+  report("diffuse, allocating", size, measure(repetitions, [&] {
+           temperatures = diffuse(temperatures, size, 0.5);
+         }));
+  for (auto const& kernel : {std::pair{Simd::None, "diffuse, scalar"},
+                             std::pair{Simd::Avx2, "diffuse, AVX2"},
+                             std::pair{Simd::Avx512, "diffuse, AVX-512"}}) {
+    auto const simd = kernel.first;
+    if (is_supported(simd)) {
+      report(kernel.second, size, measure(repetitions, [&] {
+               diffuse(temperatures.data(), new_temperatures.data(), size, 0.5,
+                       simd);
+               std::swap(temperatures, new_temperatures);
+             }));
+    }
+  }
+}
+
+void bench_heating(int size, int repetitions)
+{
+  World world(size, 0.2, 0.2, 25);
+  report("World::compute_temperatures", size,
+         measure(repetitions, [&] { world.compute_temperatures(1.); }));
+}
+
+// the separate passes over the grid done by step before they were fused
+void bench_passes(int size, int repetitions)
+{
+  World world(size, 0.2, 0.2, 25);
+  report("heat, diffuse, spread", size, measure(repetitions, [&] {
+           world.compute_temperatures(1.);
+           world.compute_diffusion();
+           world.spread();
+         }));
+}
+
+// heating and diffusion only, one step at a time or temporally blocked
+void bench_advance(int size, int repetitions)
+{
+  int const n_steps = 32;
+  World world(size, 0.2, 0.2, 25);
+  auto const stepped = measure(repetitions, [&] {
+    for (int i{0}; i < n_steps; ++i) {
+      world.compute_temperatures(1.);
+      world.compute_diffusion();
+    }
+  });
+  report("heat, diffuse", size,
+         {stepped.ms / n_steps, stepped.allocations / n_steps});
+  auto const blocked = measure(repetitions, [&] {
+    world.advance(n_steps, [](int) { return 1.; });
+  });
+  report("World::advance", size,
+         {blocked.ms / n_steps, blocked.allocations / n_steps});
+}
+
+// the stats of a step, counted from the patches or kept by the world
+void bench_stats(int size, int repetitions)
+{
+  World world(size, 0.2, 0.2, 25);
+  world.step(1.);
+  auto const& daisies = world.daisies();
+  auto const& temperatures = world.temperatures();
+  double sink{0.};
+  report("stats, counted", size, measure(repetitions, [&] {
+           sink += std::accumulate(temperatures.begin(), temperatures.end(),
+                                   0.) +
+                   std::count(daisies.begin(), daisies.end(), Daisy::Black) +
+                   std::count(daisies.begin(), daisies.end(), Daisy::White) +
+                   std::count(daisies.begin(), daisies.end(), Daisy::Barren);
+         }));
+  report("World::stats", size, measure(repetitions, [&] {
+           auto const stats = world.stats();
+           sink += stats.global_temperature + stats.n_black + stats.n_white +
+                   stats.n_barren;
+         }));
+  // use the results, so that they are computed
+  if (sink == 0.) {
+    std::printf("\n");
+  }
+}
+
+// n_worlds small worlds, stepped one at a time or together in a batch
+void bench_batch(int size, int n_worlds, int repetitions)
+{
+  std::vector<World> worlds;
+  for (int w{0}; w < n_worlds; ++w) {
+    worlds.emplace_back(size, 0.2, 0.2, 25, 1, w);
+  }
+  WorldBatch batch(worlds);
+  char name[32];
+  std::snprintf(name, sizeof name, "%d x World::step", n_worlds);
+  report(name, size, measure(repetitions, [&] {
+           for (auto& world : worlds) {
+             world.step(1.);
+           }
+         }));
+  std::snprintf(name, sizeof name, "WorldBatch::step, %d worlds", n_worlds);
+  report(name, size, measure(repetitions, [&] { batch.step(1.); }));
+}
+
+void bench_sparse(int size, int repetitions)
+{
+  // a world without daisies, once its temperatures have settled
+  World world(size, 0., 0., 25);
+  world.advance(200, [](int) { return 1.; });
+  report("World::step, settled", size,
+         measure(repetitions, [&] { world.step(1.); }));
+  world.set_sparse(1e-9);
+  world.step(1.);
+  report("World::step, sparse", size,
+         measure(repetitions, [&] { world.step(1.); }));
+}
+
+// spread alone, which must not allocate
+void bench_spread(int size, int repetitions)
+{
+  World world(size, 0.2, 0.2, 25);
+  for (int i{0}; i < 20; ++i) {
+    world.compute_temperatures(1.);
+    world.compute_diffusion();
+  }
+  report("spread", size, measure(repetitions, [&] { world.spread(); }));
+}
+
+void bench_step(int size, int repetitions, int n_threads = 1)
+{
+  World world(size, 0.2, 0.2, 25, n_threads);
+  char name[32];
+  std::snprintf(name, sizeof name, "World::step, %d thread%s", n_threads,
+                n_threads > 1 ? "s" : "");
+  report(name, size, measure(repetitions, [&] { world.step(1.); }));
+}
+
+}  // namespace
+
+int main()
+{
+  std::printf("%-28s %6s %12s %12s\n", "", "size", "ms/step", "allocs/step");
+  bench_diffusion(100, 1000);
+  bench_diffusion(1000, 20);
+  bench_heating(1000, 100);
+  bench_step(100, 1000);
+  bench_step(1000, 20);
+  bench_spread(1000, 20);
+  bench_stats(1000, 100);
+  bench_batch(20, 64, 200);
+  bench_sparse(1000, 20);
+  bench_advance(1000, 5);
+  bench_advance(4000, 2);
+  bench_passes(4000, 5);
+  bench_step(4000, 5);
+  int const n_cores = std::thread::hardware_concurrency();
+  for (int n_threads{2}; n_threads <= n_cores; n_threads *= 2) {
+    bench_step(1000, 20, n_threads);
+  }
+}
@@ -0,0 +1,242 @@
+#include "world.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A checkpoint file holds the whole state of a world. It starts with a header
+// of 64 bytes:
+//
+//   offset  size  field
+//        0     8  "DWCKPT" and the version of the layout, "01"
+//        8     4  size of the grid
+//       12     4  maximum age of the daisies
+//       16     8  seed of the random numbers
+//       24     8  number of steps taken
+//       32    24  numbers of black, white and barren patches (8 bytes each)
+//       56     8  sum of the temperatures
+//
+// followed by the temperatures (doubles), the daisies (bytes) and the ages (2
+// bytes each) of the patches, each array starting at the first multiple of 64
+// bytes after the previous one. Everything is stored little-endian, as in
+// memory, so the arrays can be used as they are once the file is mapped in
+// memory.
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Checkpoints are stored as in the memory of a little-endian machine"
+#endif
+
+namespace {
+
+constexpr char checkpoint_magic[] = "DWCKPT01";
+constexpr std::size_t magic_size = 8;
+// the magic, without the version
+constexpr std::size_t format_size = 6;
+constexpr std::size_t header_size = 64;
+
+// the offsets of the arrays of a checkpoint of n patches, and its size
+struct Layout
+{
+  std::size_t temperatures;
+  std::size_t daisies;
+  std::size_t ages;
+  std::size_t end;
+};
+
+std::size_t align(std::size_t offset)
+{
+  return (offset + 63) / 64 * 64;
+}
+
+Layout layout(std::size_t n)
+{
+  Layout l;
+  l.temperatures = header_size;
+  l.daisies = align(l.temperatures + n * sizeof(double));
+  l.ages = align(l.daisies + n * sizeof(Daisy));
+  l.end = l.ages + n * sizeof(std::uint16_t);
+  return l;
+}
+
+template<typename T>
+void store(char* at, T value)
+{
+  std::memcpy(at, &value, sizeof value);
+}
+
+template<typename T>
+T load(char const* at)
+{
+  T value;
+  std::memcpy(&value, at, sizeof value);
+  return value;
+}
+
+// a file mapped in memory, read-only
+class Mapping
+{
+  int fd_{-1};
+  void* data_{MAP_FAILED};
+  std::size_t size_{0};
+
+ public:
+  explicit Mapping(std::string const& path)
+  {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat status;
+    if (::fstat(fd_, &status) != 0) {
+      ::close(fd_);
+      throw std::runtime_error("Cannot read " + path);
+    }
+    size_ = status.st_size;
+    if (size_ == 0) {
+      return;
+    }
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data_ == MAP_FAILED) {
+      ::close(fd_);
+      throw std::runtime_error("Cannot map " + path);
+    }
+    // the arrays are read once, from the start to the end
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+
+  Mapping(Mapping const&) = delete;
+
+  Mapping& operator=(Mapping const&) = delete;
+
+  ~Mapping()
+  {
+    if (data_ != MAP_FAILED) {
+      ::munmap(data_, size_);
+    }
+    ::close(fd_);
+  }
+
+  char const* data() const
+  {
+    return static_cast<char const*>(data_);
+  }
+
+  std::size_t size() const
+  {
+    return size_;
+  }
+};
+
+}  // namespace
+
+void World::checkpoint(std::string const& path) const
+{
+  std::size_t const n = temperature_.size();
+  auto const l = layout(n);
+  char header[header_size]{};
+  std::memcpy(header, checkpoint_magic, magic_size);
+  store(header + 8, std::uint32_t(size_));
+  store(header + 12, std::uint32_t(max_age_));
+  store(header + 16, seed_);
+  store(header + 24, steps_);
+  for (int d{0}; d < 3; ++d) {
+    store(header + 32 + 8 * d, std::uint64_t(counts_[d]));
+  }
+  store(header + 56, temperature_sum_);
+
+  // the file is written under another name and renamed at the end, so that
+  // a failed checkpoint never replaces the previous one
+  auto const written = path + ".tmp";
+  {
+    std::ofstream out(written, std::ios::binary);
+    if (!out) {
+      throw std::runtime_error("Cannot open " + written);
+    }
+    std::size_t position{0};
+    auto const write_at = [&](std::size_t offset, void const* data,
+                              std::size_t bytes) {
+      char const padding[64]{};
+      out.write(padding, offset - position);
+      out.write(static_cast<char const*>(data), bytes);
+      position = offset + bytes;
+    };
+    write_at(0, header, header_size);
+    write_at(l.temperatures, temperature_.data(), n * sizeof(double));
+    write_at(l.daisies, daisy_.data(), n * sizeof(Daisy));
+    write_at(l.ages, age_.data(), n * sizeof(std::uint16_t));
+    out.flush();
+    if (!out) {
+      throw std::runtime_error("Cannot write " + written);
+    }
+  }
+  if (std::rename(written.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Cannot rename " + written + " to " + path);
+  }
+}
+
+World World::restore(std::string const& path, int n_threads)
+{
+  Mapping file(path);
+  char const* const data = file.data();
+  if (file.size() < header_size ||
+      !std::equal(data, data + format_size, checkpoint_magic)) {
+    throw std::runtime_error("Not a checkpoint file");
+  }
+  if (!std::equal(data, data + magic_size, checkpoint_magic)) {
+    throw std::runtime_error("Unsupported version of the checkpoint file");
+  }
+  auto const size = load<std::uint32_t>(data + 8);
+  auto const max_age = load<std::uint32_t>(data + 12);
+  std::uint64_t const n = std::uint64_t(size) * size;
+  if (n > std::uint64_t(std::numeric_limits<int>::max()) ||
+      max_age >= std::numeric_limits<std::uint16_t>::max()) {
+    throw std::runtime_error("Corrupted checkpoint file");
+  }
+  auto const l = layout(n);
+  if (file.size() != l.end) {
+    throw std::runtime_error("Truncated checkpoint file");
+  }
+  Counts counts;
+  for (int d{0}; d < 3; ++d) {
+    counts[d] = load<std::int64_t>(data + 32 + 8 * d);
+  }
+  // the counts must be those of the daisies, which must all be valid
+  auto const daisies = reinterpret_cast<Daisy const*>(data + l.daisies);
+  Counts found{};
+  for (std::uint64_t i{0}; i < n; ++i) {
+    auto const d = static_cast<std::uint8_t>(daisies[i]);
+    if (d > static_cast<std::uint8_t>(Daisy::Barren)) {
+      throw std::runtime_error("Corrupted checkpoint file");
+    }
+    ++found[d];
+  }
+  if (found != counts) {
+    throw std::runtime_error("Corrupted checkpoint file");
+  }
+
+  World world(0, 0., 0., 0, n_threads);
+  world.size_ = int(size);
+  world.max_age_ = int(max_age);
+  world.seed_ = load<std::uint64_t>(data + 16);
+  world.steps_ = load<std::uint64_t>(data + 24);
+  world.counts_ = counts;
+  world.temperature_sum_ = load<double>(data + 56);
+  // the arrays are copied out of the mapping: the world owns its vectors and
+  // swaps them with its buffers at every step, so it cannot keep using pages
+  // of the file
+  auto const temperatures =
+      reinterpret_cast<double const*>(data + l.temperatures);
+  auto const ages = reinterpret_cast<std::uint16_t const*>(data + l.ages);
+  world.temperature_.assign(temperatures, temperatures + n);
+  world.daisy_.assign(daisies, daisies + n);
+  world.age_.assign(ages, ages + n);
+  world.resize_buffers();
+  return world;
+}
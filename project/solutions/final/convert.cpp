@@ -0,0 +1,32 @@
+#include "output.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// convert a stats file or a snapshot file written by a run to CSV, on the
+// standard output
+int main(int argc, char* argv[])
+{
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " FILE\n";
+    return 1;
+  }
+  try {
+    char magic[8]{};
+    std::ifstream(argv[1], std::ios::binary).read(magic, sizeof magic);
+    if (std::strncmp(magic, "DWSTAT01", sizeof magic) == 0) {
+      stats_to_csv(read_stats(argv[1]), std::cout);
+      return 0;
+    }
+    SnapshotReader reader(argv[1]);
+    std::cout << "Step, Row, Column, Temperature, Daisy, Age\n";
+    Snapshot snapshot;
+    while (reader.read(snapshot)) {
+      snapshot_to_csv(snapshot, reader.size(), std::cout);
+    }
+  } catch (std::exception const& e) {
+    std::cerr << argv[0] << ": " << e.what() << '\n';
+    return 1;
+  }
+}
@@ -0,0 +1,227 @@
+#include "diffusion.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DIFFUSION_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Every interior patch has 8 neighbors and its new temperature is
+//   t * (1 - 8 * k) + k * (sum of the temperatures of the neighbors)
+// where k = diffusion_rate / 8. The kernels below compute the new
+// temperatures of columns [first, last) of an interior row, given the rows
+// above and below, adding the neighbors always in the same order.
+
+void interior_row(double const* up, double const* mid, double const* down,
+                  double* out, int first, int last, double keep, double k)
+{
+  for (int col{first}; col < last; ++col) {
+    double sum = up[col - 1];
+    sum += up[col];
+    sum += up[col + 1];
+    sum += mid[col - 1];
+    sum += mid[col + 1];
+    sum += down[col - 1];
+    sum += down[col];
+    sum += down[col + 1];
+    out[col] = mid[col] * keep + sum * k;
+  }
+}
+
+#if defined(DIFFUSION_X86)
+
+__attribute__((target("avx2"))) void interior_row_avx2(
+    double const* up, double const* mid, double const* down, double* out,
+    int first, int last, double keep, double k)
+{
+  auto const keep_v = _mm256_set1_pd(keep);
+  auto const k_v = _mm256_set1_pd(k);
+  int col{first};
+  for (; col + 4 <= last; col += 4) {
+    auto sum = _mm256_loadu_pd(up + col - 1);
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(up + col));
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(up + col + 1));
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(mid + col - 1));
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(mid + col + 1));
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + col - 1));
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + col));
+    sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + col + 1));
+    auto const t = _mm256_mul_pd(_mm256_loadu_pd(mid + col), keep_v);
+    _mm256_storeu_pd(out + col, _mm256_add_pd(t, _mm256_mul_pd(sum, k_v)));
+  }
+  interior_row(up, mid, down, out, col, last, keep, k);
+}
+
+__attribute__((target("avx512f"))) void interior_row_avx512(
+    double const* up, double const* mid, double const* down, double* out,
+    int first, int last, double keep, double k)
+{
+  auto const keep_v = _mm512_set1_pd(keep);
+  auto const k_v = _mm512_set1_pd(k);
+  int col{first};
+  for (; col + 8 <= last; col += 8) {
+    auto sum = _mm512_loadu_pd(up + col - 1);
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(up + col));
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(up + col + 1));
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(mid + col - 1));
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(mid + col + 1));
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(down + col - 1));
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(down + col));
+    sum = _mm512_add_pd(sum, _mm512_loadu_pd(down + col + 1));
+    auto const t = _mm512_mul_pd(_mm512_loadu_pd(mid + col), keep_v);
+    _mm512_storeu_pd(out + col, _mm512_add_pd(t, _mm512_mul_pd(sum, k_v)));
+  }
+  interior_row(up, mid, down, out, col, last, keep, k);
+}
+
+#endif
+
+using RowKernel = void (*)(double const*, double const*, double const*,
+                           double*, int, int, double, double);
+
+RowKernel row_kernel(Simd simd)
+{
+#if defined(DIFFUSION_X86)
+  switch (simd) {
+    case Simd::Avx512:
+      return interior_row_avx512;
+    case Simd::Avx2:
+      return interior_row_avx2;
+    case Simd::None:
+    default:
+      break;
+  }
+#endif
+  (void)simd;
+  return interior_row;
+}
+
+// new temperature of the patch in column col of a row on the border of the
+// grid, adding its neighbors in the same order as the interior kernels; up
+// and down are the rows above and below, null outside the grid, and keep is
+// the fraction of its temperature kept by the patch
+double border_patch(double const* up, double const* mid, double const* down,
+                    int size, int col, double keep, double k)
+{
+  double sum{0.};
+  for (double const* row : {up, mid, down}) {
+    if (row == nullptr) {
+      continue;
+    }
+    for (int neighborCol : {col - 1, col, col + 1}) {
+      if (neighborCol >= 0 && neighborCol < size &&
+          (row != mid || neighborCol != col)) {
+        sum += row[neighborCol];
+      }
+    }
+  }
+  return mid[col] * keep + sum * k;
+}
+
+}  // namespace
+
+bool is_supported(Simd simd)
+{
+  switch (simd) {
+#if defined(DIFFUSION_X86)
+    case Simd::Avx512:
+      return __builtin_cpu_supports("avx512f");
+    case Simd::Avx2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    case Simd::None:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Simd best_simd()
+{
+  static Simd const best = is_supported(Simd::Avx512) ? Simd::Avx512
+                           : is_supported(Simd::Avx2) ? Simd::Avx2
+                                                      : Simd::None;
+  return best;
+}
+
+void diffuse(double const* temperatures, double* new_temperatures, int size,
+             double diffusion_rate, Simd simd)
+{
+  diffuse_rows(temperatures, new_temperatures, size, diffusion_rate, 0, size,
+               simd);
+}
+
+void diffuse_rows(double const* temperatures, double* new_temperatures,
+                  int size, double diffusion_rate, int first_row, int last_row,
+                  Simd simd)
+{
+  for (int row{first_row}; row < last_row; ++row) {
+    double const* mid = temperatures + row * size;
+    diffuse_row(row > 0 ? mid - size : nullptr, mid,
+                row < size - 1 ? mid + size : nullptr,
+                new_temperatures + row * size, size, diffusion_rate, simd);
+  }
+}
+
+void diffuse_row(double const* up, double const* mid, double const* down,
+                 double* new_temperatures, int size, double diffusion_rate,
+                 Simd simd)
+{
+  diffuse_columns(up, mid, down, new_temperatures, size, diffusion_rate, 0,
+                  size, simd);
+}
+
+DiffusionWeights diffusion_weights(double diffusion_rate)
+{
+  DiffusionWeights weights;
+  weights.k = diffusion_rate / 8;
+  for (int n{0}; n < 9; ++n) {
+    weights.keep[n] = 1. - n * weights.k;
+  }
+  return weights;
+}
+
+void diffuse_columns(double const* up, double const* mid, double const* down,
+                     double* new_temperatures, int size, double diffusion_rate,
+                     int first_col, int last_col, Simd simd)
+{
+  auto const weights = diffusion_weights(diffusion_rate);
+  double const k = weights.k;
+  // the number of neighbors of a patch follows from its position: with r rows
+  // and c columns of the 3 x 3 block around it within the grid, it is
+  // r * c - 1, where r is the same for the whole row
+  int const rows = 1 + (up != nullptr) + (down != nullptr);
+  auto const keep = [&](int col) {
+    int const cols = 1 + (col > 0) + (col < size - 1);
+    return weights.keep[rows * cols - 1];
+  };
+  if (up == nullptr || down == nullptr) {
+    for (int col{first_col}; col < last_col; ++col) {
+      new_temperatures[col] =
+          border_patch(up, mid, down, size, col, keep(col), k);
+    }
+    return;
+  }
+  int const first = std::max(first_col, 1);
+  int const last = std::min(last_col, size - 1);
+  if (first_col == 0) {
+    new_temperatures[0] = border_patch(up, mid, down, size, 0, keep(0), k);
+  }
+  row_kernel(simd)(up, mid, down, new_temperatures, first, last,
+                   weights.keep[8], k);
+  if (last_col == size) {
+    new_temperatures[size - 1] =
+        border_patch(up, mid, down, size, size - 1, keep(size - 1), k);
+  }
+}
+
+std::vector<double> diffuse(std::vector<double> const& temperatures, int size,
+                            double diffusion_rate)
+{
+  std::vector<double> new_temperatures(size * size);
+  diffuse(temperatures.data(), new_temperatures.data(), size, diffusion_rate);
+  return new_temperatures;
+}
@@ -0,0 +1,63 @@
+#if !defined(DIFFUSION_H)
+#define DIFFUSION_H
+
+#include <array>
+#include <vector>
+
+// instruction sets for which the diffusion kernel is vectorized explicitly
+enum class Simd
+{
+  None,
+  Avx2,
+  Avx512
+};
+
+// the best instruction set supported by the running processor
+Simd best_simd();
+
+bool is_supported(Simd simd);
+
+// Diffuse the size * size temperatures into new_temperatures, which must not
+// overlap them. Every patch gives diffusion_rate / 8 of its temperature to
+// each of its neighbors within the grid and keeps the rest. The new
+// temperature of each patch is computed gathering the contributions of its
+// neighbors, with the same sequence of operations whatever the instruction
+// set, so the result doesn't depend on it as long as multiplications and
+// additions are not fused (-ffp-contract=off). With respect to spreading the
+// temperature of each patch to its neighbors, as done in the past, the
+// rounding errors differ; the relative difference is within 1e-14.
+void diffuse(double const* temperatures, double* new_temperatures, int size,
+             double diffusion_rate, Simd simd = best_simd());
+
+// diffuse only the rows [first_row, last_row) of the grid, reading the rows
+// next to them as well; with disjoint ranges, it can be called concurrently
+void diffuse_rows(double const* temperatures, double* new_temperatures,
+                  int size, double diffusion_rate, int first_row, int last_row,
+                  Simd simd = best_simd());
+
+// diffuse a single row of the grid, given the rows above and below it, null
+// outside the grid
+void diffuse_row(double const* up, double const* mid, double const* down,
+                 double* new_temperatures, int size, double diffusion_rate,
+                 Simd simd = best_simd());
+
+// the weights of the diffusion: a patch gets k = diffusion_rate / 8 of the
+// temperature of each neighbor and, having n neighbors, keeps keep[n] of its
+// own; every kernel combining temperatures as diffuse does must use these
+struct DiffusionWeights
+{
+  double k;
+  std::array<double, 9> keep;
+};
+
+DiffusionWeights diffusion_weights(double diffusion_rate);
+
+// diffuse only the columns [first_col, last_col) of a row, as diffuse_row
+void diffuse_columns(double const* up, double const* mid, double const* down,
+                     double* new_temperatures, int size, double diffusion_rate,
+                     int first_col, int last_col, Simd simd = best_simd());
+
+std::vector<double> diffuse(std::vector<double> const& temperatures, int size,
+                            double diffusion_rate);
+
+#endif  // DIFFUSION_H
@@ -9,10 +9,11 @@ int main()
   int max_age{25};
   World world(size, start_black_percentage, start_white_percentage, max_age);
   int iterations{500};
+  int n_threads{1};
   bool print_to_screen = true;
   if (size > 30) {
     print_to_screen = false;
   }
-  simulate(world, iterations, print_to_screen);
+  simulate(world, iterations, print_to_screen, n_threads);
   return 0;
 }
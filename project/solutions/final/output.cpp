@@ -0,0 +1,351 @@
+#include "output.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+constexpr char stats_magic[] = "DWSTAT01";
+constexpr char snapshot_magic[] = "DWSNAP01";
+constexpr std::size_t magic_size = 8;
+
+// the bits of the values, as unsigned integers of the same size
+std::uint64_t to_bits(double value)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  return bits;
+}
+
+double from_bits(std::uint64_t bits)
+{
+  double value;
+  std::memcpy(&value, &bits, sizeof value);
+  return value;
+}
+
+std::uint64_t to_bits(Daisy daisy)
+{
+  return static_cast<std::uint64_t>(daisy);
+}
+
+std::uint64_t to_bits(std::uint16_t value)
+{
+  return value;
+}
+
+template<typename T>
+T from_bits_as(std::uint64_t bits)
+{
+  if constexpr (std::is_same_v<T, double>) {
+    return from_bits(bits);
+  } else {
+    return static_cast<T>(bits);
+  }
+}
+
+void put(std::ostream& out, std::uint64_t value, int n_bytes)
+{
+  char bytes[8];
+  for (int i{0}; i < n_bytes; ++i) {
+    bytes[i] = static_cast<char>(value >> (8 * i));
+  }
+  out.write(bytes, n_bytes);
+}
+
+std::uint64_t get(char const* bytes, int n_bytes)
+{
+  std::uint64_t value{0};
+  for (int i{0}; i < n_bytes; ++i) {
+    value |= std::uint64_t{static_cast<unsigned char>(bytes[i])} << (8 * i);
+  }
+  return value;
+}
+
+// read n_bytes little-endian bytes; false at the end of the file, throws if
+// the file ends in the middle
+bool get(std::istream& in, std::uint64_t& value, int n_bytes)
+{
+  char bytes[8];
+  in.read(bytes, n_bytes);
+  if (in.gcount() == 0 && in.eof()) {
+    return false;
+  }
+  if (in.gcount() != n_bytes) {
+    throw std::runtime_error("Truncated file");
+  }
+  value = get(bytes, n_bytes);
+  return true;
+}
+
+std::uint64_t get_required(std::istream& in, int n_bytes)
+{
+  std::uint64_t value;
+  if (!get(in, value, n_bytes)) {
+    throw std::runtime_error("Truncated file");
+  }
+  return value;
+}
+
+void check_magic(std::istream& in, char const* magic)
+{
+  char bytes[magic_size];
+  in.read(bytes, magic_size);
+  if (in.gcount() != magic_size ||
+      !std::equal(bytes, bytes + magic_size, magic)) {
+    throw std::runtime_error("Not a file of the expected kind");
+  }
+}
+
+}  // namespace
+
+Stats make_stats(World const& world, std::uint64_t step,
+                 double solar_luminosity)
+{
+  auto const s = world.stats();
+  return {step, solar_luminosity, s.global_temperature, s.n_black,
+          s.n_white, s.n_barren};
+}
+
+void packbits(std::uint8_t const* data, std::size_t n,
+              std::vector<std::uint8_t>& out)
+{
+  std::size_t i{0};
+  while (i != n) {
+    // length of the run of equal bytes starting at i
+    std::size_t run{1};
+    while (i + run != n && run != 128 && data[i + run] == data[i]) {
+      ++run;
+    }
+    if (run > 1) {
+      out.push_back(static_cast<std::uint8_t>(257 - run));
+      out.push_back(data[i]);
+      i += run;
+      continue;
+    }
+    // literal bytes, up to the next run of at least two equal bytes
+    std::size_t literal{1};
+    while (i + literal != n && literal != 128 &&
+           !(i + literal + 1 != n &&
+             data[i + literal] == data[i + literal + 1])) {
+      ++literal;
+    }
+    out.push_back(static_cast<std::uint8_t>(literal - 1));
+    out.insert(out.end(), data + i, data + i + literal);
+    i += literal;
+  }
+}
+
+std::vector<std::uint8_t> unpackbits(std::uint8_t const* data, std::size_t size,
+                                     std::size_t n)
+{
+  std::vector<std::uint8_t> out;
+  out.reserve(n);
+  std::size_t i{0};
+  while (i != size) {
+    int const header = data[i++];
+    if (header < 128) {
+      std::size_t const literal = header + 1;
+      if (size - i < literal || n - out.size() < literal) {
+        throw std::runtime_error("Corrupted packbits data");
+      }
+      out.insert(out.end(), data + i, data + i + literal);
+      i += literal;
+    } else if (header > 128) {
+      std::size_t const run = 257 - header;
+      if (i == size || n - out.size() < run) {
+        throw std::runtime_error("Corrupted packbits data");
+      }
+      out.insert(out.end(), run, data[i++]);
+    }
+  }
+  if (out.size() != n) {
+    throw std::runtime_error("Corrupted packbits data");
+  }
+  return out;
+}
+
+StatsWriter::StatsWriter(std::string const& path)
+    : out_(path, std::ios::binary)
+{
+  if (!out_) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  out_.write(stats_magic, magic_size);
+}
+
+void StatsWriter::write(Stats const& stats)
+{
+  put(out_, stats.step, 8);
+  put(out_, to_bits(stats.solar_luminosity), 8);
+  put(out_, to_bits(stats.global_temperature), 8);
+  put(out_, stats.n_black, 8);
+  put(out_, stats.n_white, 8);
+  put(out_, stats.n_barren, 8);
+  if (!out_) {
+    throw std::runtime_error("Cannot write the stats");
+  }
+}
+
+void StatsWriter::flush()
+{
+  out_.flush();
+}
+
+std::vector<Stats> read_stats(std::string const& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  check_magic(in, stats_magic);
+  std::vector<Stats> stats;
+  char record[stats_record_size];
+  while (in.read(record, stats_record_size)) {
+    stats.push_back({get(record, 8), from_bits(get(record + 8, 8)),
+                     from_bits(get(record + 16, 8)), get(record + 24, 8),
+                     get(record + 32, 8), get(record + 40, 8)});
+  }
+  if (in.gcount() != 0) {
+    throw std::runtime_error("Truncated file");
+  }
+  return stats;
+}
+
+void write_csv(Stats const& stats, std::ostream& out)
+{
+  out << stats.solar_luminosity << ',' << stats.global_temperature << ','
+      << stats.n_black << ',' << stats.n_white << ',' << stats.n_barren
+      << '\n';
+}
+
+void stats_to_csv(std::vector<Stats> const& stats, std::ostream& out)
+{
+  out << "Solar luminosity, Global temperature, Black daisies, White "
+         "daisies, Barren lands\n";
+  for (auto const& s : stats) {
+    write_csv(s, out);
+  }
+}
+
+SnapshotWriter::SnapshotWriter(std::string const& path, int size)
+    : out_(path, std::ios::binary), size_{size}
+{
+  if (!out_) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  out_.write(snapshot_magic, magic_size);
+  put(out_, size, 4);
+}
+
+template<typename T>
+void SnapshotWriter::write_column(T const* values)
+{
+  std::size_t const n = std::size_t(size_) * size_;
+  planes_.resize(n * sizeof(T));
+  for (std::size_t byte{0}; byte < sizeof(T); ++byte) {
+    std::uint8_t* const plane = planes_.data() + byte * n;
+    for (std::size_t i{0}; i < n; ++i) {
+      plane[i] = static_cast<std::uint8_t>(to_bits(values[i]) >> (8 * byte));
+    }
+  }
+  compressed_.clear();
+  packbits(planes_.data(), planes_.size(), compressed_);
+  put(out_, compressed_.size(), 8);
+  out_.write(reinterpret_cast<char const*>(compressed_.data()),
+             compressed_.size());
+}
+
+void SnapshotWriter::write(std::uint64_t step, World const& world)
+{
+  if (world.size() != size_) {
+    throw std::runtime_error("Snapshot of a world of a different size");
+  }
+  put(out_, step, 8);
+  write_column(world.temperatures().data());
+  write_column(world.daisies().data());
+  write_column(world.ages().data());
+  if (!out_) {
+    throw std::runtime_error("Cannot write the snapshot");
+  }
+}
+
+void SnapshotWriter::write(Snapshot const& snapshot)
+{
+  std::size_t const n = std::size_t(size_) * size_;
+  if (snapshot.temperatures.size() != n || snapshot.daisies.size() != n ||
+      snapshot.ages.size() != n) {
+    throw std::runtime_error("Snapshot of a world of a different size");
+  }
+  put(out_, snapshot.step, 8);
+  write_column(snapshot.temperatures.data());
+  write_column(snapshot.daisies.data());
+  write_column(snapshot.ages.data());
+  if (!out_) {
+    throw std::runtime_error("Cannot write the snapshot");
+  }
+}
+
+void SnapshotWriter::flush()
+{
+  out_.flush();
+}
+
+SnapshotReader::SnapshotReader(std::string const& path)
+    : in_(path, std::ios::binary)
+{
+  if (!in_) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  check_magic(in_, snapshot_magic);
+  size_ = int(get_required(in_, 4));
+}
+
+template<typename T>
+void SnapshotReader::read_column(std::vector<T>& values)
+{
+  std::size_t const n = std::size_t(size_) * size_;
+  auto const size = get_required(in_, 8);
+  std::vector<std::uint8_t> compressed(size);
+  in_.read(reinterpret_cast<char*>(compressed.data()), size);
+  if (std::uint64_t(in_.gcount()) != size) {
+    throw std::runtime_error("Truncated file");
+  }
+  auto const planes = unpackbits(compressed.data(), size, n * sizeof(T));
+  values.assign(n, T{});
+  for (std::size_t i{0}; i < n; ++i) {
+    std::uint64_t bits{0};
+    for (std::size_t byte{0}; byte < sizeof(T); ++byte) {
+      bits |= std::uint64_t{planes[byte * n + i]} << (8 * byte);
+    }
+    values[i] = from_bits_as<T>(bits);
+  }
+}
+
+bool SnapshotReader::read(Snapshot& snapshot)
+{
+  if (!get(in_, snapshot.step, 8)) {
+    return false;
+  }
+  read_column(snapshot.temperatures);
+  read_column(snapshot.daisies);
+  read_column(snapshot.ages);
+  if (std::any_of(snapshot.daisies.begin(), snapshot.daisies.end(),
+                  [](Daisy d) { return d > Daisy::Barren; })) {
+    throw std::runtime_error("Corrupted snapshot");
+  }
+  return true;
+}
+
+void snapshot_to_csv(Snapshot const& snapshot, int size, std::ostream& out)
+{
+  for (int idx{0}; idx < size * size; ++idx) {
+    out << snapshot.step << ',' << idx / size << ',' << idx % size << ','
+        << snapshot.temperatures[idx] << ','
+        << static_cast<int>(snapshot.daisies[idx]) << ','
+        << snapshot.ages[idx] << '\n';
+  }
+}
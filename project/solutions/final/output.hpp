@@ -0,0 +1,124 @@
+#if !defined(OUTPUT_H)
+#define OUTPUT_H
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Binary output of a run. All the numbers are stored little-endian, whatever
+// the machine.
+//
+// A stats file starts with the 8 bytes "DWSTAT01", followed by one record of
+// stats_record_size bytes per step: the fields of Stats, in order, each 8
+// bytes long, so record i starts at byte 8 + i * stats_record_size.
+//
+// A snapshot file starts with the 8 bytes "DWSNAP01" and the size of the
+// grid (4 bytes), followed by the snapshots. A snapshot is the step (8 bytes)
+// and then three columns, the temperatures, the daisies and the ages of the
+// patches, each stored as its length in bytes (8 bytes) and its data. The
+// data of a column are its byte planes (first the least significant byte of
+// every value, then the next one, ...) compressed together with packbits.
+
+struct Stats
+{
+  std::uint64_t step;
+  double solar_luminosity;
+  double global_temperature;
+  std::uint64_t n_black;
+  std::uint64_t n_white;
+  std::uint64_t n_barren;
+};
+
+constexpr int stats_record_size = 48;
+
+Stats make_stats(World const& world, std::uint64_t step,
+                 double solar_luminosity);
+
+// append to out the PackBits encoding of n bytes, as in TIFF: a header byte
+// h followed by h + 1 literal bytes if h < 128, or by one byte repeated 257 - h
+// times if h > 128
+void packbits(std::uint8_t const* data, std::size_t n,
+              std::vector<std::uint8_t>& out);
+
+// decode the PackBits encoding of n bytes; throws if it doesn't hold exactly n
+// bytes
+std::vector<std::uint8_t> unpackbits(std::uint8_t const* data, std::size_t size,
+                                     std::size_t n);
+
+class StatsWriter
+{
+  std::ofstream out_;
+
+ public:
+  explicit StatsWriter(std::string const& path);
+
+  void write(Stats const& stats);
+
+  void flush();
+};
+
+std::vector<Stats> read_stats(std::string const& path);
+
+// write the stats as a line of CSV, as World::write_to_file does
+void write_csv(Stats const& stats, std::ostream& out);
+
+// write the stats of a stats file as CSV, with the header of data.csv
+void stats_to_csv(std::vector<Stats> const& stats, std::ostream& out);
+
+struct Snapshot
+{
+  std::uint64_t step{0};
+  std::vector<double> temperatures;
+  std::vector<Daisy> daisies;
+  std::vector<std::uint16_t> ages;
+};
+
+class SnapshotWriter
+{
+  std::ofstream out_;
+  int size_;
+  // the buffers are kept across snapshots
+  std::vector<std::uint8_t> planes_;
+  std::vector<std::uint8_t> compressed_;
+
+  template<typename T>
+  void write_column(T const* values);
+
+ public:
+  SnapshotWriter(std::string const& path, int size);
+
+  void write(std::uint64_t step, World const& world);
+
+  void write(Snapshot const& snapshot);
+
+  void flush();
+};
+
+class SnapshotReader
+{
+  std::ifstream in_;
+  int size_{0};
+
+  template<typename T>
+  void read_column(std::vector<T>& values);
+
+ public:
+  explicit SnapshotReader(std::string const& path);
+
+  int size() const
+  {
+    return size_;
+  }
+
+  // read the next snapshot; false at the end of the file
+  bool read(Snapshot& snapshot);
+};
+
+// write the patches of a snapshot as CSV, one per line
+void snapshot_to_csv(Snapshot const& snapshot, int size, std::ostream& out);
+
+#endif  // OUTPUT_H
@@ -27,20 +27,8 @@ void Patch::sprout(Daisy daisy)
 
 void Patch::absorb_light(double solar_luminosity)
 {
-  double albedo{0.};
-  switch (daisy_) {
-    case Daisy::Black:
-      albedo = Albedo::black;
-      break;
-    case Daisy::White:
-      albedo = Albedo::white;
-      break;
-    case Daisy::Barren:
-    default:
-      albedo = Albedo::surface;
-      break;
-  }
-  temperature_ = (temperature_ + local_heating(solar_luminosity, albedo)) * 0.5;
+  temperature_ =
+      (temperature_ + local_heating(solar_luminosity, albedo(daisy_))) * 0.5;
 }
 
 void Patch::age_and_die(int max_age)
@@ -1,27 +1,49 @@
 #if !defined(PATCH_H)
 #define PATCH_H
 
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 
-enum class Daisy
+enum class Daisy : std::uint8_t
 {
   Black,
   White,
   Barren
 };
 
+struct Albedo
+{
+  static constexpr double black = 0.25;
+  static constexpr double white = 0.75;
+  static constexpr double surface = 0.4;
+};
+
+inline double albedo(Daisy daisy)
+{
+  switch (daisy) {
+    case Daisy::Black:
+      return Albedo::black;
+    case Daisy::White:
+      return Albedo::white;
+    case Daisy::Barren:
+    default:
+      return Albedo::surface;
+  }
+}
+
+inline double seeding_threshold(double temperature)
+{
+  return ((0.1457 * temperature) - (0.0032 * (temperature * temperature)) -
+          0.6443);
+}
+
 class Patch
 {
   Daisy daisy_{Daisy::Barren};
   double temperature_{0.};
   int age_{0};
-  struct Albedo
-  {
-    static constexpr double black = 0.25;
-    static constexpr double white = 0.75;
-    static constexpr double surface = 0.4;
-  };
 
  public:
   Patch() = default;
@@ -48,10 +70,9 @@ class Patch
 
   void age_and_die(int max_age);
 
-  double seeding_threshold()
+  double seeding_threshold() const
   {
-    return ((0.1457 * temperature_) - (0.0032 * (temperature_ * temperature_)) -
-            0.6443);
+    return ::seeding_threshold(temperature_);
   }
 
   void sprout(Daisy daisy);
@@ -60,6 +81,11 @@ class Patch
   {
     return daisy_;
   };
+
+  int age() const
+  {
+    return age_;
+  }
 };
 
 inline double local_heating(double solar_luminosity, double albedo)
@@ -69,4 +95,16 @@ inline double local_heating(double solar_luminosity, double albedo)
                                  : 80.;
 }
 
+// the heating of a patch for each kind of daisy, indexed by Daisy: within a
+// step the luminosity is the same for all the patches, so it takes only
+// three evaluations of local_heating
+using HeatingTable = std::array<double, 3>;
+
+inline HeatingTable heating_table(double solar_luminosity)
+{
+  return {local_heating(solar_luminosity, albedo(Daisy::Black)),
+          local_heating(solar_luminosity, albedo(Daisy::White)),
+          local_heating(solar_luminosity, albedo(Daisy::Barren))};
+}
+
 #endif  // PATCH_H
@@ -0,0 +1,157 @@
+#include "philox.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PHILOX_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The kernels below draw the counters [first, n). The vectorized ones
+// compute the same as the scalar one, word by word.
+
+void draw(std::uint32_t const* counter0, std::uint32_t const* counter1,
+          std::uint32_t const* counter2, std::uint32_t const* key0,
+          std::uint32_t const* key1, std::uint32_t* words, int first, int n)
+{
+  for (int i{first}; i < n; ++i) {
+    auto const random = philox4x32({counter0[i], counter1[i], counter2[i], 0},
+                                   {key0[i], key1[i]});
+    for (int j{0}; j < 3; ++j) {
+      words[j * n + i] = random[j];
+    }
+  }
+}
+
+#if defined(PHILOX_X86)
+
+// Philox on 4 or 8 counters at a time, each 32-bit word in a 64-bit element:
+// the multiplications of the rounds are those of the low halves of the
+// elements, so the high halves can be left dirty and are dropped when the
+// words are stored.
+
+__attribute__((target("avx2"))) void draw_avx2(
+    std::uint32_t const* counter0, std::uint32_t const* counter1,
+    std::uint32_t const* counter2, std::uint32_t const* key0,
+    std::uint32_t const* key1, std::uint32_t* words, int first, int n)
+{
+  auto const m0 = _mm256_set1_epi64x(0xD2511F53);
+  auto const m1 = _mm256_set1_epi64x(0xCD9E8D57);
+  auto const bump0 = _mm256_set1_epi64x(0x9E3779B9);
+  auto const bump1 = _mm256_set1_epi64x(0xBB67AE85);
+  auto const low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  int i{first};
+  for (; i + 4 <= n; i += 4) {
+    auto c0 = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(counter0 + i)));
+    auto c1 = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(counter1 + i)));
+    auto c2 = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(counter2 + i)));
+    auto c3 = _mm256_setzero_si256();
+    auto k0 = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(key0 + i)));
+    auto k1 = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(key1 + i)));
+    for (int round{0}; round < 10; ++round) {
+      if (round > 0) {
+        k0 = _mm256_add_epi64(k0, bump0);
+        k1 = _mm256_add_epi64(k1, bump1);
+      }
+      auto const p0 = _mm256_mul_epu32(c0, m0);
+      auto const p1 = _mm256_mul_epu32(c2, m1);
+      c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1),
+                            k0);
+      c1 = p1;
+      c2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3),
+                            k1);
+      c3 = p0;
+    }
+    std::uint32_t* out = words + i;
+    for (auto const c : {c0, c1, c2}) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                       _mm256_castsi256_si128(
+                           _mm256_permutevar8x32_epi32(c, low_halves)));
+      out += n;
+    }
+  }
+  draw(counter0, counter1, counter2, key0, key1, words, i, n);
+}
+
+// GCC 12 warns about the undefined vectors its AVX-512 intrinsics start from
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f"))) void draw_avx512(
+    std::uint32_t const* counter0, std::uint32_t const* counter1,
+    std::uint32_t const* counter2, std::uint32_t const* key0,
+    std::uint32_t const* key1, std::uint32_t* words, int first, int n)
+{
+  auto const m0 = _mm512_set1_epi64(0xD2511F53);
+  auto const m1 = _mm512_set1_epi64(0xCD9E8D57);
+  auto const bump0 = _mm512_set1_epi64(0x9E3779B9);
+  auto const bump1 = _mm512_set1_epi64(0xBB67AE85);
+  int i{first};
+  for (; i + 8 <= n; i += 8) {
+    auto c0 = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter0 + i)));
+    auto c1 = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter1 + i)));
+    auto c2 = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(counter2 + i)));
+    auto c3 = _mm512_setzero_si512();
+    auto k0 = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(key0 + i)));
+    auto k1 = _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(reinterpret_cast<__m256i const*>(key1 + i)));
+    for (int round{0}; round < 10; ++round) {
+      if (round > 0) {
+        k0 = _mm512_add_epi64(k0, bump0);
+        k1 = _mm512_add_epi64(k1, bump1);
+      }
+      auto const p0 = _mm512_mul_epu32(c0, m0);
+      auto const p1 = _mm512_mul_epu32(c2, m1);
+      c0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c1),
+                            k0);
+      c1 = p1;
+      c2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c3),
+                            k1);
+      c3 = p0;
+    }
+    std::uint32_t* out = words + i;
+    for (auto const c : {c0, c1, c2}) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                          _mm512_cvtepi64_epi32(c));
+      out += n;
+    }
+  }
+  draw(counter0, counter1, counter2, key0, key1, words, i, n);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+}  // namespace
+
+void philox_draw(std::uint32_t const* counter0, std::uint32_t const* counter1,
+                 std::uint32_t const* counter2, std::uint32_t const* key0,
+                 std::uint32_t const* key1, std::uint32_t* words, int n,
+                 Simd simd)
+{
+#if defined(PHILOX_X86)
+  switch (simd) {
+    case Simd::Avx512:
+      draw_avx512(counter0, counter1, counter2, key0, key1, words, 0, n);
+      return;
+    case Simd::Avx2:
+      draw_avx2(counter0, counter1, counter2, key0, key1, words, 0, n);
+      return;
+    case Simd::None:
+    default:
+      break;
+  }
+#endif
+  (void)simd;
+  draw(counter0, counter1, counter2, key0, key1, words, 0, n);
+}
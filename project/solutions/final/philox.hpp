@@ -0,0 +1,55 @@
+#if !defined(PHILOX_H)
+#define PHILOX_H
+
+#include "diffusion.hpp"
+
+#include <array>
+#include <cstdint>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3", SC11), a counter-based random number generator: the random words are a
+// function of a counter and a key only, so any of them can be computed
+// independently of the others, in any order.
+
+using PhiloxCounter = std::array<std::uint32_t, 4>;
+using PhiloxKey = std::array<std::uint32_t, 2>;
+
+inline PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key)
+{
+  for (int round{0}; round < 10; ++round) {
+    if (round > 0) {
+      key[0] += 0x9E3779B9;
+      key[1] += 0xBB67AE85;
+    }
+    auto const p0 = std::uint64_t{0xD2511F53} * counter[0];
+    auto const p1 = std::uint64_t{0xCD9E8D57} * counter[2];
+    counter = {std::uint32_t(p1 >> 32) ^ counter[1] ^ key[0], std::uint32_t(p1),
+               std::uint32_t(p0 >> 32) ^ counter[3] ^ key[1],
+               std::uint32_t(p0)};
+  }
+  return counter;
+}
+
+// the first three words of n counters at once: counter i is {counter0[i],
+// counter1[i], counter2[i], 0}, with key {key0[i], key1[i]}, and its word j
+// goes to words[j * n + i]; vectorized with simd, which doesn't change the
+// words
+void philox_draw(std::uint32_t const* counter0, std::uint32_t const* counter1,
+                 std::uint32_t const* counter2, std::uint32_t const* key0,
+                 std::uint32_t const* key1, std::uint32_t* words, int n,
+                 Simd simd = best_simd());
+
+// uniform in [0, 1), with 53 random bits taken from two words
+inline double to_unit(std::uint32_t high, std::uint32_t low)
+{
+  auto const bits = (std::uint64_t{high} << 21) | (low >> 11);
+  return double(bits) * 0x1p-53;
+}
+
+// uniform in [0, n), from a word; the bias is below n / 2^32
+inline int to_index(std::uint32_t word, int n)
+{
+  return int((std::uint64_t{word} * std::uint64_t(n)) >> 32);
+}
+
+#endif  // PHILOX_H
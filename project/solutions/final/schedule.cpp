@@ -0,0 +1,140 @@
+#include "schedule.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+Schedule ramp(double first, double last, int n_steps)
+{
+  if (n_steps < 1) {
+    throw std::runtime_error("Number of steps must be >= 1");
+  }
+  Schedule schedule(n_steps, first);
+  for (int i{1}; i < n_steps; ++i) {
+    schedule[i] = first + (last - first) * i / (n_steps - 1);
+  }
+  return schedule;
+}
+
+Schedule loop(double low, double high, int n_steps)
+{
+  auto schedule = ramp(low, high, n_steps);
+  auto const down = ramp(high, low, n_steps);
+  schedule.insert(schedule.end(), down.begin(), down.end());
+  return schedule;
+}
+
+Schedule read_schedule(std::string const& path)
+{
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  Schedule schedule;
+  double luminosity;
+  while (in >> luminosity) {
+    schedule.push_back(luminosity);
+  }
+  if (!in.eof()) {
+    throw std::runtime_error("Not a luminosity in " + path);
+  }
+  return schedule;
+}
+
+Schedule parse_schedule(std::string const& spec)
+{
+  auto const kind = spec.substr(0, spec.find(':'));
+  if (kind != "ramp" && kind != "loop") {
+    return read_schedule(spec);
+  }
+  std::istringstream in(spec.substr(kind.size()));
+  double from;
+  double to;
+  int n_steps;
+  char c1;
+  char c2;
+  char c3;
+  if (!(in >> c1 >> from >> c2 >> to >> c3 >> n_steps) || c1 != ':' ||
+      c2 != ':' || c3 != ':' || !in.eof()) {
+    throw std::runtime_error("Wrong schedule " + spec);
+  }
+  return kind == "ramp" ? ramp(from, to, n_steps) : loop(from, to, n_steps);
+}
+
+namespace {
+
+// step the world with the schedule, keeping the stats of every step
+void run(World& world, Schedule const& schedule, std::vector<Stats>& stats)
+{
+  world.set_threads(1);
+  stats.clear();
+  stats.reserve(schedule.size());
+  for (std::size_t i{0}; i < schedule.size(); ++i) {
+    world.step(schedule[i]);
+    stats.push_back(make_stats(world, i + 1, schedule[i]));
+  }
+}
+
+}  // namespace
+
+std::vector<std::vector<Stats>> run_sweep(
+    std::vector<World> worlds, std::vector<Schedule> const& schedules,
+    int n_threads)
+{
+  if (worlds.size() != schedules.size()) {
+    throw std::runtime_error("One schedule per world is needed");
+  }
+  int const n_runs = worlds.size();
+  std::vector<std::vector<Stats>> results(n_runs);
+  // the runs may take different times, so every thread takes the next run
+  // left when it's done with one
+  std::atomic<int> next_run{0};
+  ThreadPool pool{n_threads};
+  pool.run([&](int) {
+    for (int r{next_run++}; r < n_runs; r = next_run++) {
+      run(worlds[r], schedules[r], results[r]);
+    }
+  });
+  return results;
+}
+
+EnsembleStats run_ensemble(
+    std::function<World(std::uint64_t)> const& make_world,
+    Schedule const& schedule, int n_runs, std::uint64_t first_seed,
+    int n_threads)
+{
+  EnsembleStats ensemble(schedule);
+  ThreadPool pool{n_threads};
+  std::vector<std::vector<Stats>> results(n_threads);
+  for (int first{0}; first < n_runs; first += n_threads) {
+    int const n = std::min(n_threads, n_runs - first);
+    pool.run([&](int thread) {
+      if (thread < n) {
+        World world = make_world(first_seed + first + thread);
+        run(world, schedule, results[thread]);
+      }
+    });
+    for (int thread{0}; thread < n; ++thread) {
+      ensemble.add(results[thread]);
+    }
+  }
+  return ensemble;
+}
+
+void write_sweep(std::vector<std::vector<Stats>> const& runs,
+                 std::ostream& out)
+{
+  out << "Run, Step, Solar luminosity, Global temperature, Black daisies, "
+         "White daisies, Barren lands\n";
+  for (std::size_t r{0}; r < runs.size(); ++r) {
+    for (auto const& stats : runs[r]) {
+      out << r << ',' << stats.step << ',';
+      write_csv(stats, out);
+    }
+  }
+}
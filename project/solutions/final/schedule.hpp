@@ -0,0 +1,52 @@
+#if !defined(SCHEDULE_H)
+#define SCHEDULE_H
+
+#include "output.hpp"
+#include "statistics.hpp"
+#include "world.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// the solar luminosity of each step of a run
+using Schedule = std::vector<double>;
+
+// n_steps luminosities going linearly from first to last, both included
+Schedule ramp(double first, double last, int n_steps);
+
+// a hysteresis loop: n_steps luminosities going from low to high, then
+// n_steps going back from high to low
+Schedule loop(double low, double high, int n_steps);
+
+// the luminosities listed in a file, separated by white space
+Schedule read_schedule(std::string const& path);
+
+// "ramp:FIRST:LAST:N_STEPS", "loop:LOW:HIGH:N_STEPS" or the path of a file
+Schedule parse_schedule(std::string const& spec);
+
+// Step each world with its schedule, all of them concurrently on n_threads
+// threads, each world on one thread; the stats of step i of world r are
+// result[r][i]. The runs are independent: their random numbers are drawn
+// from the stream of their own world.
+std::vector<std::vector<Stats>> run_sweep(
+    std::vector<World> worlds, std::vector<Schedule> const& schedules,
+    int n_threads);
+
+// Run n_runs worlds with the schedule, the r-th made by make_world(first_seed
+// + r), n_threads of them at a time, each on one thread. The stats of the
+// runs are added to the ensemble as they complete, always in the order of the
+// runs, so the result doesn't depend on the number of threads and only
+// n_threads runs are kept in memory.
+EnsembleStats run_ensemble(
+    std::function<World(std::uint64_t)> const& make_world,
+    Schedule const& schedule, int n_runs, std::uint64_t first_seed,
+    int n_threads);
+
+// write the stats of all the runs as CSV, one line per step of each run
+void write_sweep(std::vector<std::vector<Stats>> const& runs,
+                 std::ostream& out);
+
+#endif  // SCHEDULE_H
@@ -0,0 +1,73 @@
+#if !defined(SPSC_RING_H)
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// A lock-free ring of slots shared by one producer thread and one consumer
+// thread. The slots are reused, so values with buffers (e.g. vectors) keep
+// their capacity: the producer fills the slot returned by write_slot and
+// commits it, the consumer reads the slot returned by read_slot and releases
+// it.
+template<typename T>
+class SpscRing
+{
+  std::vector<T> slots_;
+  std::size_t mask_;
+  // number of slots released by the consumer and committed by the producer;
+  // on separate cache lines, since each is written by a different thread
+  alignas(64) std::atomic<std::size_t> released_{0};
+  alignas(64) std::atomic<std::size_t> committed_{0};
+
+ public:
+  // capacity must be a power of two
+  explicit SpscRing(std::size_t capacity)
+      : slots_(capacity), mask_{capacity - 1}
+  {
+    if (capacity == 0 || (capacity & mask_) != 0) {
+      throw std::runtime_error("Ring capacity must be a power of two");
+    }
+  }
+
+  std::size_t capacity() const
+  {
+    return slots_.size();
+  }
+
+  // the next free slot, null if the ring is full; producer only
+  T* write_slot()
+  {
+    auto const committed = committed_.load(std::memory_order_relaxed);
+    if (committed - released_.load(std::memory_order_acquire) ==
+        slots_.size()) {
+      return nullptr;
+    }
+    return &slots_[committed & mask_];
+  }
+
+  void commit()
+  {
+    committed_.store(committed_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+  }
+
+  // the oldest committed slot, null if the ring is empty; consumer only
+  T* read_slot()
+  {
+    auto const released = released_.load(std::memory_order_relaxed);
+    if (committed_.load(std::memory_order_acquire) == released) {
+      return nullptr;
+    }
+    return &slots_[released & mask_];
+  }
+
+  void release()
+  {
+    released_.store(released_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+  }
+};
+
+#endif  // SPSC_RING_H
@@ -0,0 +1,148 @@
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+void RunningStats::add(double value)
+{
+  ++n_;
+  double const delta = value - mean_;
+  mean_ += delta / n_;
+  m2_ += delta * (value - mean_);
+}
+
+P2Quantile::P2Quantile(double p) : p_{p}
+{
+  if (!(p >= 0. && p <= 1.)) {
+    throw std::runtime_error("Quantile must be in [0, 1]");
+  }
+}
+
+void P2Quantile::adjust(int i)
+{
+  double const d = desired_[i] - positions_[i];
+  if (!((d >= 1. && positions_[i + 1] - positions_[i] > 1.) ||
+        (d <= -1. && positions_[i - 1] - positions_[i] < -1.))) {
+    return;
+  }
+  int const s = d > 0. ? 1 : -1;
+  auto const& q = heights_;
+  auto const& n = positions_;
+  // piecewise-parabolic prediction of the height at the new position, or
+  // linear if it isn't between the neighbors
+  double const above = (q[i + 1] - q[i]) / (n[i + 1] - n[i]);
+  double const below = (q[i] - q[i - 1]) / (n[i] - n[i - 1]);
+  double height = q[i] + s / (n[i + 1] - n[i - 1]) *
+                             ((n[i] - n[i - 1] + s) * above +
+                              (n[i + 1] - n[i] - s) * below);
+  if (!(q[i - 1] < height && height < q[i + 1])) {
+    height = q[i] + s * (q[i + s] - q[i]) / (n[i + s] - n[i]);
+  }
+  heights_[i] = height;
+  positions_[i] += s;
+}
+
+void P2Quantile::add(double value)
+{
+  if (n_ < 5) {
+    // the first values are kept sorted, as the initial markers
+    auto const end = heights_.begin() + n_;
+    auto const at = std::upper_bound(heights_.begin(), end, value);
+    std::copy_backward(at, end, end + 1);
+    *at = value;
+    ++n_;
+    if (n_ == 5) {
+      positions_ = {0., 1., 2., 3., 4.};
+      desired_ = {0., 2. * p_, 4. * p_, 2. + 2. * p_, 4.};
+    }
+    return;
+  }
+  ++n_;
+  int k;
+  if (value < heights_[0]) {
+    heights_[0] = value;
+    k = 0;
+  } else if (value >= heights_[4]) {
+    heights_[4] = value;
+    k = 3;
+  } else {
+    k = std::upper_bound(heights_.begin() + 1, heights_.end(), value) -
+        heights_.begin() - 1;
+  }
+  for (int i{k + 1}; i < 5; ++i) {
+    positions_[i] += 1.;
+  }
+  std::array<double, 5> const increments{0., p_ / 2., p_, (1. + p_) / 2., 1.};
+  for (int i{0}; i < 5; ++i) {
+    desired_[i] += increments[i];
+  }
+  for (int i{1}; i < 4; ++i) {
+    adjust(i);
+  }
+}
+
+double P2Quantile::value() const
+{
+  if (n_ == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  if (n_ == 1) {
+    return heights_[0];
+  }
+  if (n_ <= 5) {
+    // interpolated between the sorted values
+    double const position = p_ * (n_ - 1);
+    int const i = std::min<int>(position, n_ - 2);
+    return heights_[i] + (position - i) * (heights_[i + 1] - heights_[i]);
+  }
+  return heights_[2];
+}
+
+EnsembleStats::EnsembleStats(std::vector<double> const& luminosities)
+    : luminosities_(luminosities), steps_(luminosities.size())
+{
+}
+
+void EnsembleStats::add(std::vector<Stats> const& run)
+{
+  if (run.size() != steps_.size()) {
+    throw std::runtime_error("Run with a different number of steps");
+  }
+  for (std::size_t i{0}; i < run.size(); ++i) {
+    auto& step = steps_[i];
+    step[0].add(run[i].global_temperature);
+    step[1].add(run[i].n_black);
+    step[2].add(run[i].n_white);
+    step[3].add(run[i].n_barren);
+  }
+  ++n_runs_;
+}
+
+void write_ensembles(std::vector<EnsembleStats> const& ensembles,
+                     std::ostream& out)
+{
+  out << "Ensemble, Step, Solar luminosity, Runs";
+  for (char const* name : {"Global temperature", "Black daisies",
+                           "White daisies", "Barren lands"}) {
+    out << ", " << name << " mean, " << name << " std dev, " << name
+        << " 5%, " << name << " median, " << name << " 95%";
+  }
+  out << '\n';
+  for (std::size_t e{0}; e < ensembles.size(); ++e) {
+    auto const& ensemble = ensembles[e];
+    for (int step{0}; step < ensemble.steps(); ++step) {
+      out << e << ',' << step + 1 << ',' << ensemble.luminosity(step) << ','
+          << ensemble.runs();
+      for (int q{0}; q < 4; ++q) {
+        auto const& d = ensemble.distribution(step, Quantity(q));
+        out << ',' << d.moments.mean() << ','
+            << std::sqrt(d.moments.variance()) << ',' << d.low.value() << ','
+            << d.median.value() << ',' << d.high.value();
+      }
+      out << '\n';
+    }
+  }
+}
@@ -0,0 +1,132 @@
+#if !defined(STATISTICS_H)
+#define STATISTICS_H
+
+#include "output.hpp"
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// the mean and the variance of a stream of values, updated one value at a
+// time (Welford)
+class RunningStats
+{
+  std::uint64_t n_{0};
+  double mean_{0.};
+  // sum of the squares of the differences from the mean
+  double m2_{0.};
+
+ public:
+  void add(double value);
+
+  std::uint64_t count() const
+  {
+    return n_;
+  }
+
+  double mean() const
+  {
+    return mean_;
+  }
+
+  // the sample variance, 0 with less than two values
+  double variance() const
+  {
+    return n_ > 1 ? m2_ / (n_ - 1) : 0.;
+  }
+};
+
+// An estimate of the p-quantile of a stream of values, kept in five markers
+// (the P-square algorithm, Jain and Chlamtac, 1985): the markers are the
+// minimum, the maximum, the estimated quantile and two quantiles around it,
+// moved towards their desired positions as the values come. The quantile is
+// exact up to five values.
+class P2Quantile
+{
+  double p_;
+  std::uint64_t n_{0};
+  // heights and positions of the markers, and their desired positions
+  std::array<double, 5> heights_{};
+  std::array<double, 5> positions_{};
+  std::array<double, 5> desired_{};
+
+  void adjust(int i);
+
+ public:
+  explicit P2Quantile(double p);
+
+  void add(double value);
+
+  // NaN without values
+  double value() const;
+};
+
+// what is kept of the values of a quantity over the runs of an ensemble
+struct Distribution
+{
+  RunningStats moments;
+  P2Quantile low{0.05};
+  P2Quantile median{0.5};
+  P2Quantile high{0.95};
+
+  void add(double value)
+  {
+    moments.add(value);
+    low.add(value);
+    median.add(value);
+    high.add(value);
+  }
+};
+
+enum class Quantity
+{
+  GlobalTemperature,
+  BlackDaisies,
+  WhiteDaisies,
+  BarrenLands
+};
+
+// The distributions of the stats of each step over many runs, added one run
+// at a time, in a memory that doesn't depend on the number of runs.
+class EnsembleStats
+{
+  std::vector<double> luminosities_;
+  std::uint64_t n_runs_{0};
+  std::vector<std::array<Distribution, 4>> steps_;
+
+ public:
+  // the runs have a step for each of the luminosities
+  explicit EnsembleStats(std::vector<double> const& luminosities);
+
+  // add the stats of the steps of a run
+  void add(std::vector<Stats> const& run);
+
+  std::uint64_t runs() const
+  {
+    return n_runs_;
+  }
+
+  int steps() const
+  {
+    return steps_.size();
+  }
+
+  double luminosity(int step) const
+  {
+    return luminosities_[step];
+  }
+
+  Distribution const& distribution(int step, Quantity quantity) const
+  {
+    return steps_[step][static_cast<int>(quantity)];
+  }
+};
+
+// write the distributions of several ensembles as CSV, one line per step of
+// each ensemble: its mean, standard deviation, 5% quantile, median and 95%
+// quantile for each quantity
+void write_ensembles(std::vector<EnsembleStats> const& ensembles,
+                     std::ostream& out);
+
+#endif  // STATISTICS_H
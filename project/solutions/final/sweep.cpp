@@ -0,0 +1,69 @@
+#include "schedule.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Run a world for each luminosity schedule given, all of them concurrently,
+// and write the stats of all the runs to a CSV file. With -n, run an
+// ensemble of worlds with different seeds for each schedule instead, and
+// write the distribution of their stats at each step.
+int main(int argc, char* argv[])
+{
+  int n_runs{0};
+  int first{1};
+  if (argc > 2 && std::strcmp(argv[1], "-n") == 0) {
+    n_runs = std::atoi(argv[2]);
+    first = 3;
+  }
+  if (argc < first + 2 || (first == 3 && n_runs < 1)) {
+    std::cerr << "Usage: " << argv[0] << " [-n RUNS] OUTPUT SCHEDULE...\n"
+              << "where SCHEDULE is ramp:FIRST:LAST:N_STEPS, "
+                 "loop:LOW:HIGH:N_STEPS or a file of luminosities\n";
+    return 1;
+  }
+  try {
+    int size{100};
+    double start_black_percentage{0.2};
+    double start_white_percentage{0.2};
+    int max_age{25};
+    auto const make_world = [&](std::uint64_t seed) {
+      return World(size, start_black_percentage, start_white_percentage,
+                   max_age, 1, seed);
+    };
+    std::vector<Schedule> schedules;
+    for (int i{first + 1}; i < argc; ++i) {
+      schedules.push_back(parse_schedule(argv[i]));
+    }
+    int const n_threads =
+        std::max(1, int(std::thread::hardware_concurrency()));
+    std::ofstream out(argv[first]);
+    if (!out) {
+      std::cerr << argv[0] << ": cannot open " << argv[first] << '\n';
+      return 1;
+    }
+    if (n_runs == 0) {
+      // the run of each schedule has a seed of its own
+      std::vector<World> worlds;
+      for (std::size_t r{0}; r < schedules.size(); ++r) {
+        worlds.push_back(make_world(r));
+      }
+      write_sweep(run_sweep(std::move(worlds), schedules, n_threads), out);
+    } else {
+      std::vector<EnsembleStats> ensembles;
+      for (auto const& schedule : schedules) {
+        ensembles.push_back(
+            run_ensemble(make_world, schedule, n_runs, 0, n_threads));
+      }
+      write_ensembles(ensembles, out);
+    }
+  } catch (std::exception const& e) {
+    std::cerr << argv[0] << ": " << e.what() << '\n';
+    return 1;
+  }
+}
@@ -1,8 +1,27 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "async_output.hpp"
+#include "batch.hpp"
 #include "doctest.h"
+#include "output.hpp"
 #include "patch.hpp"
+#include "philox.hpp"
+#include "schedule.hpp"
+#include "statistics.hpp"
 #include "world.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
 auto sum_all(std::vector<double> const& v)
 {
   double sum{0.};
@@ -12,8 +31,86 @@ auto sum_all(std::vector<double> const& v)
   return sum;
 }
 
+// diffusion spreading the temperature of each patch to its neighbors
+std::vector<double> scatter_diffuse(std::vector<double> const& temperatures,
+                                    int size, double diffusion_rate)
+{
+  std::vector<double> new_temperatures(size * size, 0.);
+  for (int row{0}; row < size; ++row) {
+    for (int col{0}; col < size; ++col) {
+      double temperature = temperatures[row * size + col];
+      double const diffused_temperature = temperature * diffusion_rate / 8;
+      for (int neighborRow : {row - 1, row, row + 1}) {
+        for (int neighborCol : {col - 1, col, col + 1}) {
+          if (neighborRow >= 0 && neighborRow < size && neighborCol >= 0 &&
+              neighborCol < size &&
+              (neighborRow != row || neighborCol != col)) {
+            new_temperatures[neighborRow * size + neighborCol] +=
+                diffused_temperature;
+            temperature -= diffused_temperature;
+          }
+        }
+      }
+      new_temperatures[row * size + col] += temperature;
+    }
+  }
+  return new_temperatures;
+}
+
+// the daisies after spreading those of world as the serial model does:
+// visiting the patches in order, drawing from a single engine
+std::vector<Daisy> serial_spread(World const& world, int max_age,
+                                 std::mt19937& eng)
+{
+  int const size = world.size();
+  auto const patches = world.patches();
+  std::vector<Daisy> daisies(size * size);
+  for (int idx{0}; idx < size * size; ++idx) {
+    auto const& p = patches[idx];
+    daisies[idx] = p.age() + 1 > max_age ? Daisy::Barren : p.daisy();
+  }
+  auto new_daisies = daisies;
+  std::uniform_real_distribution<double> flat;
+  for (int idx{0}; idx < size * size; ++idx) {
+    if (daisies[idx] == Daisy::Barren ||
+        flat(eng) >= patches[idx].seeding_threshold()) {
+      continue;
+    }
+    std::vector<int> barren_neighbors;
+    int const row = idx / size;
+    int const col = idx % size;
+    for (int neighborRow : {row - 1, row, row + 1}) {
+      for (int neighborCol : {col - 1, col, col + 1}) {
+        if (neighborRow >= 0 && neighborRow < size && neighborCol >= 0 &&
+            neighborCol < size &&
+            new_daisies[neighborRow * size + neighborCol] == Daisy::Barren) {
+          barren_neighbors.push_back(neighborRow * size + neighborCol);
+        }
+      }
+    }
+    if (!barren_neighbors.empty()) {
+      std::uniform_int_distribution<> flat_i(0, barren_neighbors.size() - 1);
+      new_daisies[barren_neighbors[flat_i(eng)]] = daisies[idx];
+    }
+  }
+  return new_daisies;
+}
+
+// remove the files written by a test when it ends, whether it passes or not
+struct RemoveFiles
+{
+  std::vector<std::string> paths;
+  ~RemoveFiles()
+  {
+    for (auto const& path : paths) {
+      std::remove(path.c_str());
+    }
+  }
+};
+
 TEST_CASE("Test simulation")
 {
+  RemoveFiles const cleanup{{"data.csv"}};
   World world(3, 0.3, 0.1, 25);
   int number_of_lines = 0;
   std::string line;
@@ -46,6 +143,27 @@ TEST_CASE("Test simulation")
   }
 }
 
+TEST_CASE("Test visual simulation")
+{
+  RemoveFiles const cleanup{{"data.csv"}};
+  // the screen output goes to a string
+  std::ostringstream screen;
+  auto const cout_buffer = std::cout.rdbuf(screen.rdbuf());
+  World world(3, 0.3, 0.1, 25);
+  simulate(world, 50, true, 2, 1000);
+  std::cout.rdbuf(cout_buffer);
+
+  int number_of_lines = 0;
+  std::string line;
+  std::ifstream my_file("data.csv");
+  while (std::getline(my_file, line)) {
+    ++number_of_lines;
+  }
+  CHECK(number_of_lines == 51);
+  CHECK(screen.str().find("\033c") != std::string::npos);
+  CHECK_THROWS(simulate(world, 1, true, 1, 0));
+}
+
 TEST_CASE("Test patches")
 {
   Patch p0(Daisy::Barren, 0., 0);
@@ -101,6 +219,20 @@ TEST_CASE("Test World")
     CHECK_THROWS(World{4, -1, 0, 0});
     CHECK_THROWS(World{4, 0, -1, 0});
     CHECK_THROWS(World{4, 0.51, 0.67, 0});
+    CHECK_THROWS(World{4, 0.5, 0.5, -1});
+    CHECK_THROWS(World{4, 0.5, 0.5, 65535});
+  }
+  SUBCASE("Patches match the stored state")
+  {
+    world1.step(1.);
+    auto const patches = world1.patches();
+    REQUIRE(patches.size() == 16);
+    REQUIRE(world1.temperatures().size() == 16);
+    for (int i{0}; i < 16; ++i) {
+      CHECK(patches[i].daisy() == world1.daisies()[i]);
+      CHECK(patches[i].temperature() == world1.temperatures()[i]);
+      CHECK(patches[i].age() <= 25);
+    }
   }
   SUBCASE("World 1 population count")
   {
@@ -137,6 +269,729 @@ TEST_CASE("Test World")
   }
 }
 
+TEST_CASE("Test parallel step")
+{
+  World serial(30, 0.3, 0.3, 25);
+  World parallel(30, 0.3, 0.3, 25, 4);
+  CHECK(parallel.threads() == 4);
+  for (int i{0}; i < 5; ++i) {
+    serial.step(1.);
+    parallel.step(1.);
+  }
+  CHECK(parallel.temperatures() == serial.temperatures());
+  CHECK(parallel.daisies() == serial.daisies());
+
+  SUBCASE("More threads than rows")
+  {
+    World small(3, 0.3, 0.3, 25, 8);
+    World small_serial(3, 0.3, 0.3, 25);
+    small.step(1.);
+    small_serial.step(1.);
+    CHECK(small.temperatures() == small_serial.temperatures());
+  }
+  SUBCASE("Copies run on their own threads")
+  {
+    World copy{parallel};
+    CHECK(copy.threads() == 4);
+    copy.step(1.);
+    serial.step(1.);
+    CHECK(copy.temperatures() == serial.temperatures());
+  }
+}
+
+TEST_CASE("Test fused step")
+{
+  // the single sweep of step computes the same as the separate passes
+  World fused(40, 0.3, 0.3, 25, 3);
+  World separate(40, 0.3, 0.3, 25);
+  for (int i{0}; i < 5; ++i) {
+    fused.step(1. + 0.1 * i);
+    separate.compute_temperatures(1. + 0.1 * i);
+    separate.compute_diffusion();
+    separate.spread();
+  }
+  CHECK(fused.temperatures() == separate.temperatures());
+  CHECK(fused.daisies() == separate.daisies());
+}
+
+// the stats kept by the world match the ones computed from its patches
+void check_stats(World const& world)
+{
+  auto const stats = world.stats();
+  auto const& daisies = world.daisies();
+  auto const count = [&](Daisy daisy) {
+    return std::uint64_t(std::count(daisies.begin(), daisies.end(), daisy));
+  };
+  CHECK(stats.n_black == count(Daisy::Black));
+  CHECK(stats.n_white == count(Daisy::White));
+  CHECK(stats.n_barren == count(Daisy::Barren));
+  auto const& temperatures = world.temperatures();
+  CHECK(stats.global_temperature ==
+        doctest::Approx(sum_all(temperatures) / temperatures.size())
+            .epsilon(1e-12));
+}
+
+TEST_CASE("Test stats")
+{
+  World world(40, 0.3, 0.3, 25, 3);
+  check_stats(world);
+  for (int i{0}; i < 40; ++i) {
+    world.step(0.8 + 0.02 * i);
+    check_stats(world);
+  }
+  world.set_threads(1);
+  world.compute_temperatures(1.);
+  check_stats(world);
+  world.compute_diffusion();
+  check_stats(world);
+  world.spread();
+  check_stats(world);
+  world.advance(3, [](int) { return 1.2; });
+  check_stats(world);
+}
+
+TEST_CASE("Test world batch")
+{
+  // a batch steps its worlds exactly as they would be stepped alone, with
+  // any instruction set; 11 worlds fill the vectors and leave a tail
+  int const n = 11;
+  for (int size : {1, 2, 3, 20}) {
+    std::vector<World> worlds;
+    for (std::uint64_t seed{0}; seed < n; ++seed) {
+      worlds.emplace_back(size, 0.3, 0.3, 25, 1, seed);
+    }
+    std::vector<WorldBatch> batches;
+    for (auto simd : {Simd::None, Simd::Avx2, Simd::Avx512}) {
+      if (is_supported(simd)) {
+        batches.emplace_back(worlds, simd);
+      }
+    }
+    for (auto const& batch : batches) {
+      CHECK(batch.size() == size);
+      CHECK(batch.worlds() == n);
+    }
+    for (int i{0}; i < 30; ++i) {
+      if (i % 2 == 0) {
+        std::vector<double> luminosities;
+        for (int w{0}; w < n; ++w) {
+          luminosities.push_back(0.7 + 0.05 * w + 0.01 * i);
+          worlds[w].step(luminosities.back());
+        }
+        for (auto& batch : batches) {
+          batch.step(luminosities);
+        }
+      } else {
+        for (auto& world : worlds) {
+          world.step(1.);
+        }
+        for (auto& batch : batches) {
+          batch.step(1.);
+        }
+      }
+    }
+    for (auto const& batch : batches) {
+      for (int w{0}; w < n; ++w) {
+        auto const world = batch.world(w);
+        CHECK(world.temperatures() == worlds[w].temperatures());
+        CHECK(world.daisies() == worlds[w].daisies());
+        CHECK(world.ages() == worlds[w].ages());
+        check_stats(world);
+      }
+    }
+  }
+  std::vector<World> const worlds{World(5, 0.3, 0.3, 25),
+                                  World(6, 0.3, 0.3, 25)};
+  CHECK_THROWS(WorldBatch(worlds));
+  CHECK_THROWS(WorldBatch(std::vector<World>{}));
+  WorldBatch batch(std::vector<World>(2, World(5, 0.3, 0.3, 25)));
+  CHECK_THROWS(batch.step(std::vector<double>{1.}));
+  CHECK_THROWS(batch.world(2));
+}
+
+TEST_CASE("Test sprout across words")
+{
+  // the bits of the rows of the sprouts straddle 64-bit words; a batch,
+  // which reads the daisies directly, gives the reference
+  for (int size : {63, 64, 65, 130}) {
+    World world(size, 0.3, 0.3, 25, 2, 7);
+    WorldBatch batch(std::vector<World>{world}, Simd::None);
+    for (int i{0}; i < 20; ++i) {
+      world.step(1.);
+      batch.step(1.);
+    }
+    auto const reference = batch.world(0);
+    CHECK(world.daisies() == reference.daisies());
+    CHECK(world.ages() == reference.ages());
+    CHECK(world.temperatures() == reference.temperatures());
+  }
+}
+
+TEST_CASE("Test sparse step")
+{
+  // the daisies die out, then the temperatures settle and the tiles are
+  // skipped; with a tolerance of 0, the steps are still the dense ones
+  World dense(100, 0.01, 0.01, 25, 2, 3);
+  World sparse = dense;
+  sparse.set_sparse(0., true);
+  CHECK(sparse.active_fraction() == 1.);
+  double least_active{1.};
+  for (int i{0}; i < 300; ++i) {
+    double const luminosity = i < 250 ? 0.5 : 0.6;
+    dense.step(luminosity);
+    sparse.step(luminosity);
+    least_active = std::min(least_active, sparse.active_fraction());
+  }
+  CHECK(least_active < 0.5);
+  CHECK(sparse.temperatures() == dense.temperatures());
+  CHECK(sparse.daisies() == dense.daisies());
+  CHECK(sparse.ages() == dense.ages());
+  check_stats(sparse);
+  // with a tolerance, they stay within it
+  sparse.set_sparse(1e-9, true);
+  for (int i{0}; i < 100; ++i) {
+    dense.step(0.6);
+    CHECK_NOTHROW(sparse.step(0.6));
+  }
+  CHECK(sparse.active_fraction() == 0.);
+  for (int idx{0}; idx < 100 * 100; ++idx) {
+    CHECK(std::abs(sparse.temperatures()[idx] - dense.temperatures()[idx]) <=
+          1e-9);
+  }
+  sparse.set_sparse(-1.);
+  CHECK(sparse.active_fraction() == 1.);
+}
+
+TEST_CASE("Test checkpoint")
+{
+  RemoveFiles const cleanup{{"checkpoint.bin"}};
+  World world(37, 0.3, 0.3, 25, 2);
+  for (int i{0}; i < 7; ++i) {
+    world.step(1.);
+  }
+  world.checkpoint("checkpoint.bin");
+  World restored = World::restore("checkpoint.bin", 3);
+  CHECK(restored.size() == 37);
+  CHECK(restored.threads() == 3);
+  CHECK(restored.temperatures() == world.temperatures());
+  CHECK(restored.daisies() == world.daisies());
+  CHECK(restored.ages() == world.ages());
+  for (int i{0}; i < 30; ++i) {
+    world.step(0.9 + 0.01 * i);
+    restored.step(0.9 + 0.01 * i);
+  }
+  CHECK(restored.temperatures() == world.temperatures());
+  CHECK(restored.daisies() == world.daisies());
+  CHECK(restored.ages() == world.ages());
+  CHECK(restored.stats().n_black == world.stats().n_black);
+  check_stats(restored);
+
+  SUBCASE("Wrong files")
+  {
+    CHECK_THROWS(World::restore("missing.bin"));
+    {
+      std::ofstream out("checkpoint.bin", std::ios::binary);
+    }
+    CHECK_THROWS(World::restore("checkpoint.bin"));
+    world.checkpoint("checkpoint.bin");
+    std::string contents;
+    {
+      std::ifstream in("checkpoint.bin", std::ios::binary);
+      contents.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+    }
+    auto const write = [](std::string const& contents) {
+      std::ofstream("checkpoint.bin", std::ios::binary) << contents;
+    };
+    write(contents.substr(0, contents.size() - 1));
+    CHECK_THROWS(World::restore("checkpoint.bin"));
+    auto corrupted = contents;
+    corrupted[7] = '2';
+    write(corrupted);
+    CHECK_THROWS(World::restore("checkpoint.bin"));
+    corrupted = contents;
+    corrupted[32] += 1;
+    write(corrupted);
+    CHECK_THROWS(World::restore("checkpoint.bin"));
+    // counts adding up to the number of patches, but not those of the daisies
+    corrupted = contents;
+    std::int64_t counts[2];
+    std::memcpy(counts, &corrupted[32], sizeof counts);
+    ++counts[0];
+    --counts[1];
+    std::memcpy(&corrupted[32], counts, sizeof counts);
+    write(corrupted);
+    CHECK_THROWS(World::restore("checkpoint.bin"));
+    write(contents);
+    CHECK(World::restore("checkpoint.bin").daisies() == world.daisies());
+  }
+}
+
+TEST_CASE("Test advance")
+{
+  auto const luminosity = [](int i) { return 0.8 + 0.01 * i; };
+  for (int size : {1, 3, 20, 70}) {
+    for (int n_steps : {0, 1, 8, 21}) {
+      for (int tile_rows : {0, 1, 7}) {
+        World blocked(size, 0.3, 0.3, 25, 2);
+        World stepped(size, 0.3, 0.3, 25);
+        blocked.advance(n_steps, luminosity, tile_rows);
+        for (int i{0}; i < n_steps; ++i) {
+          stepped.compute_temperatures(luminosity(i));
+          stepped.compute_diffusion();
+        }
+        CHECK(blocked.temperatures() == stepped.temperatures());
+        CHECK(blocked.daisies() == stepped.daisies());
+      }
+    }
+  }
+  CHECK_THROWS(World(3, 0.3, 0.3, 25).advance(1, luminosity, -1));
+}
+
+TEST_CASE("Test parallel spread")
+{
+  // the daisies spread by the world, in parallel, and by the serial model,
+  // from the same states, counted over several steps
+  int const size = 100;
+  World world(size, 0.3, 0.3, 25, 4);
+  std::mt19937 eng;
+  long world_black{0};
+  long world_white{0};
+  long serial_black{0};
+  long serial_white{0};
+  for (int step{0}; step < 20; ++step) {
+    world.compute_temperatures(1.);
+    world.compute_diffusion();
+    auto const serial = serial_spread(world, 25, eng);
+    serial_black += std::count(serial.begin(), serial.end(), Daisy::Black);
+    serial_white += std::count(serial.begin(), serial.end(), Daisy::White);
+    world.spread();
+    auto const& daisies = world.daisies();
+    world_black += std::count(daisies.begin(), daisies.end(), Daisy::Black);
+    world_white += std::count(daisies.begin(), daisies.end(), Daisy::White);
+  }
+  // the counts are sums of many almost independent draws: their difference
+  // is within a few standard deviations, of the order of their square root
+  CHECK(std::abs(world_black - serial_black) < 5 * std::sqrt(serial_black));
+  CHECK(std::abs(world_white - serial_white) < 5 * std::sqrt(serial_white));
+}
+
+TEST_CASE("Test packbits")
+{
+  std::vector<std::vector<std::uint8_t>> inputs{
+      {}, {7}, {7, 7}, {1, 2, 3}, {1, 2, 2, 3, 3, 3, 4}};
+  inputs.emplace_back(300, 42);
+  std::vector<std::uint8_t> mixed;
+  for (int i{0}; i < 1000; ++i) {
+    mixed.push_back(i % 7 < 3 ? 5 : std::uint8_t(i * 31));
+  }
+  inputs.push_back(mixed);
+  for (auto const& input : inputs) {
+    std::vector<std::uint8_t> packed;
+    packbits(input.data(), input.size(), packed);
+    CHECK(unpackbits(packed.data(), packed.size(), input.size()) == input);
+  }
+  std::vector<std::uint8_t> const run(300, 42);
+  std::vector<std::uint8_t> packed;
+  packbits(run.data(), run.size(), packed);
+  CHECK(packed.size() == 6);
+  CHECK_THROWS(unpackbits(packed.data(), packed.size(), 299));
+  CHECK_THROWS(unpackbits(packed.data(), packed.size() - 1, 300));
+}
+
+TEST_CASE("Test binary output")
+{
+  RemoveFiles const cleanup{{"stats.bin", "stats.csv", "snapshots.bin"}};
+  World world(13, 0.3, 0.2, 25);
+  SUBCASE("Stats")
+  {
+    std::ostringstream csv;
+    {
+      StatsWriter writer("stats.bin");
+      std::ofstream out_file("stats.csv");
+      out_file << "Solar luminosity, Global temperature, Black daisies, White "
+                  "daisies, Barren lands\n";
+      for (int i{0}; i < 5; ++i) {
+        world.step(0.9 + 0.1 * i);
+        writer.write(make_stats(world, i, 0.9 + 0.1 * i));
+        world.write_to_file(out_file, 0.9 + 0.1 * i);
+      }
+    }
+    auto const stats = read_stats("stats.bin");
+    REQUIRE(stats.size() == 5);
+    CHECK(stats[4].step == 4);
+    CHECK(stats[4].solar_luminosity == 0.9 + 0.1 * 4);
+    CHECK(stats[4].n_black + stats[4].n_white + stats[4].n_barren == 169);
+    stats_to_csv(stats, csv);
+    std::ifstream in("stats.csv");
+    std::string const expected{std::istreambuf_iterator<char>(in),
+                               std::istreambuf_iterator<char>()};
+    CHECK(csv.str() == expected);
+  }
+  SUBCASE("Snapshots")
+  {
+    std::vector<Snapshot> expected;
+    {
+      SnapshotWriter writer("snapshots.bin", 13);
+      for (int i{0}; i < 3; ++i) {
+        world.step(1.);
+        writer.write(i, world);
+        expected.push_back({std::uint64_t(i), world.temperatures(),
+                            world.daisies(), world.ages()});
+      }
+      CHECK_THROWS(writer.write(3, World(4, 0.3, 0.2, 25)));
+    }
+    SnapshotReader reader("snapshots.bin");
+    CHECK(reader.size() == 13);
+    Snapshot snapshot;
+    for (auto const& e : expected) {
+      REQUIRE(reader.read(snapshot));
+      CHECK(snapshot.step == e.step);
+      CHECK(snapshot.temperatures == e.temperatures);
+      CHECK(snapshot.daisies == e.daisies);
+      CHECK(snapshot.ages == e.ages);
+    }
+    CHECK_FALSE(reader.read(snapshot));
+  }
+  SUBCASE("Wrong files")
+  {
+    {
+      std::ofstream out("stats.bin", std::ios::binary);
+      out << "DWSTAT01" << std::string(50, 'x');
+    }
+    CHECK_THROWS(read_stats("stats.bin"));
+    CHECK_THROWS(SnapshotReader("stats.bin"));
+    CHECK_THROWS(read_stats("missing.bin"));
+  }
+}
+
+TEST_CASE("Test async output")
+{
+  RemoveFiles const cleanup{{"async.csv", "async.bin"}};
+  World world(13, 0.3, 0.2, 25);
+  SUBCASE("Ring")
+  {
+    CHECK_THROWS(SpscRing<int>(3));
+    SpscRing<int> ring(4);
+    std::vector<int> received;
+    std::thread consumer([&] {
+      while (received.size() != 1000) {
+        if (int const* value = ring.read_slot()) {
+          received.push_back(*value);
+          ring.release();
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    for (int i{0}; i < 1000; ++i) {
+      int* slot;
+      while ((slot = ring.write_slot()) == nullptr) {
+        std::this_thread::yield();
+      }
+      *slot = i;
+      ring.commit();
+    }
+    consumer.join();
+    std::vector<int> expected(1000);
+    std::iota(expected.begin(), expected.end(), 0);
+    CHECK(received == expected);
+  }
+  SUBCASE("Stats")
+  {
+    std::vector<Stats> expected;
+    {
+      AsyncOutput output({"async.csv", "async.bin", ""}, 13);
+      for (int i{0}; i < 2000; ++i) {
+        world.step(1.);
+        expected.push_back(make_stats(world, i, 1.));
+        output.publish(expected.back());
+      }
+      output.close();
+      CHECK_THROWS(output.publish(expected.back()));
+    }
+    auto const stats = read_stats("async.bin");
+    REQUIRE(stats.size() == expected.size());
+    CHECK(stats.back().step == expected.back().step);
+    CHECK(stats.back().n_black == expected.back().n_black);
+    std::ostringstream csv;
+    stats_to_csv(expected, csv);
+    std::ifstream in("async.csv");
+    std::string const written{std::istreambuf_iterator<char>(in),
+                              std::istreambuf_iterator<char>()};
+    CHECK(written == csv.str());
+  }
+  SUBCASE("Blocking snapshots are all written")
+  {
+    std::vector<std::vector<Daisy>> expected;
+    {
+      AsyncOutput output({"", "", "async.bin"}, 13);
+      for (int i{0}; i < 20; ++i) {
+        world.step(1.);
+        CHECK(output.publish(i, world));
+        expected.push_back(world.daisies());
+      }
+      CHECK(output.dropped_snapshots() == 0);
+      CHECK_THROWS(output.publish(0, World(4, 0.3, 0.2, 25)));
+    }
+    SnapshotReader reader("async.bin");
+    Snapshot snapshot;
+    for (int i{0}; i < 20; ++i) {
+      REQUIRE(reader.read(snapshot));
+      CHECK(snapshot.step == std::uint64_t(i));
+      CHECK(snapshot.daisies == expected[i]);
+    }
+    CHECK_FALSE(reader.read(snapshot));
+  }
+  SUBCASE("Dropped snapshots are counted")
+  {
+    int written{0};
+    std::uint64_t dropped{0};
+    {
+      AsyncOutput output({"", "", "async.bin"}, 13, SnapshotPolicy::Drop);
+      for (int i{0}; i < 200; ++i) {
+        written += output.publish(i, world);
+      }
+      dropped = output.dropped_snapshots();
+    }
+    CHECK(written + dropped == 200);
+    SnapshotReader reader("async.bin");
+    Snapshot snapshot;
+    int read{0};
+    std::uint64_t last_step{0};
+    while (reader.read(snapshot)) {
+      CHECK((read == 0 || snapshot.step > last_step));
+      last_step = snapshot.step;
+      ++read;
+    }
+    CHECK(read == written);
+  }
+  SUBCASE("Wrong files")
+  {
+    CHECK_THROWS(AsyncOutput({"missing/async.csv", "", ""}, 13));
+    CHECK_THROWS(AsyncOutput({"", "", "async.bin"}, 13,
+                             SnapshotPolicy::Block, 3));
+  }
+}
+
+TEST_CASE("Test luminosity sweep")
+{
+  RemoveFiles const cleanup{{"schedule.txt"}};
+  SUBCASE("Schedules")
+  {
+    CHECK(ramp(0.5, 1.5, 5) == Schedule{0.5, 0.75, 1., 1.25, 1.5});
+    CHECK(ramp(0.5, 1.5, 1) == Schedule{0.5});
+    CHECK(loop(1., 2., 3) == Schedule{1., 1.5, 2., 2., 1.5, 1.});
+    CHECK_THROWS(ramp(0.5, 1.5, 0));
+    CHECK(parse_schedule("ramp:0.5:1.5:5") == ramp(0.5, 1.5, 5));
+    CHECK(parse_schedule("loop:1:2:3") == loop(1., 2., 3));
+    CHECK_THROWS(parse_schedule("ramp:0.5:1.5"));
+    CHECK_THROWS(parse_schedule("loop:1:2:3x"));
+    {
+      std::ofstream out("schedule.txt");
+      out << "0.9 1\n1.1\n";
+    }
+    CHECK(parse_schedule("schedule.txt") == Schedule{0.9, 1., 1.1});
+    {
+      std::ofstream out("schedule.txt");
+      out << "0.9 x\n";
+    }
+    CHECK_THROWS(read_schedule("schedule.txt"));
+    CHECK_THROWS(read_schedule("missing.txt"));
+  }
+  SUBCASE("Runs")
+  {
+    World const world(20, 0.3, 0.3, 25);
+    std::vector<Schedule> const schedules{
+        ramp(0.6, 1.4, 30), loop(0.6, 1.4, 10), ramp(1., 1., 5)};
+    auto const runs = run_sweep(std::vector<World>(3, world), schedules, 2);
+    REQUIRE(runs.size() == 3);
+    for (int r{0}; r < 3; ++r) {
+      // the same as running the world alone
+      World alone{world};
+      REQUIRE(runs[r].size() == schedules[r].size());
+      for (std::size_t i{0}; i < schedules[r].size(); ++i) {
+        alone.step(schedules[r][i]);
+        auto const stats = make_stats(alone, i + 1, schedules[r][i]);
+        CHECK(runs[r][i].step == stats.step);
+        CHECK(runs[r][i].global_temperature == stats.global_temperature);
+        CHECK(runs[r][i].n_black == stats.n_black);
+      }
+    }
+    std::ostringstream csv;
+    write_sweep(runs, csv);
+    auto const text = csv.str();
+    CHECK(std::count(text.begin(), text.end(), '\n') == 1 + 30 + 20 + 5);
+    CHECK_THROWS(run_sweep({world}, schedules, 1));
+  }
+}
+
+TEST_CASE("Test ensemble")
+{
+  SUBCASE("Seeds")
+  {
+    World const a(20, 0.3, 0.3, 25, 1, 1);
+    World const b(20, 0.3, 0.3, 25, 1, 2);
+    CHECK(a.daisies() != b.daisies());
+    World c(20, 0.3, 0.3, 25, 1, 2);
+    World d{b};
+    c.step(1.);
+    d.step(1.);
+    CHECK(c.daisies() == d.daisies());
+  }
+  SUBCASE("Running stats")
+  {
+    RunningStats stats;
+    CHECK(stats.variance() == 0.);
+    for (double x : {2., 4., 4., 4., 5., 5., 7., 9.}) {
+      stats.add(x);
+    }
+    CHECK(stats.count() == 8);
+    CHECK(stats.mean() == doctest::Approx(5.));
+    CHECK(stats.variance() == doctest::Approx(32. / 7.));
+  }
+  SUBCASE("Quantiles")
+  {
+    CHECK_THROWS(P2Quantile(1.5));
+    P2Quantile median(0.5);
+    CHECK(std::isnan(median.value()));
+    for (double x : {3., 1., 2.}) {
+      median.add(x);
+    }
+    CHECK(median.value() == 2.);
+    std::mt19937 eng;
+    std::uniform_real_distribution<> uniform;
+    P2Quantile low(0.05);
+    P2Quantile high(0.95);
+    for (int i{0}; i < 20000; ++i) {
+      double const x = uniform(eng);
+      median.add(x);
+      low.add(x);
+      high.add(x);
+    }
+    CHECK(median.value() == doctest::Approx(0.5).epsilon(0.02));
+    CHECK(low.value() == doctest::Approx(0.05).epsilon(0.1));
+    CHECK(high.value() == doctest::Approx(0.95).epsilon(0.02));
+  }
+  SUBCASE("Runs")
+  {
+    auto const make_world = [](std::uint64_t seed) {
+      return World(15, 0.3, 0.3, 25, 1, seed);
+    };
+    auto const schedule = ramp(0.8, 1.2, 10);
+    auto const ensemble = run_ensemble(make_world, schedule, 5, 7, 2);
+    CHECK(ensemble.runs() == 5);
+    CHECK(ensemble.steps() == 10);
+    RunningStats temperature;
+    for (std::uint64_t seed{7}; seed < 12; ++seed) {
+      World world = make_world(seed);
+      for (int i{0}; i < 4; ++i) {
+        world.step(schedule[i]);
+      }
+      temperature.add(world.stats().global_temperature);
+    }
+    auto const& d = ensemble.distribution(3, Quantity::GlobalTemperature);
+    CHECK(d.moments.mean() == temperature.mean());
+    CHECK(d.moments.variance() == temperature.variance());
+    // the same whatever the number of threads
+    std::ostringstream parallel;
+    std::ostringstream serial;
+    write_ensembles({ensemble}, parallel);
+    write_ensembles({run_ensemble(make_world, schedule, 5, 7, 1)}, serial);
+    CHECK(parallel.str() == serial.str());
+    CHECK_THROWS(EnsembleStats(schedule).add({}));
+  }
+}
+
+TEST_CASE("Test Philox")
+{
+  // known answers from the reference implementation, Random123
+  CHECK(philox4x32({0, 0, 0, 0}, {0, 0}) ==
+        PhiloxCounter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+  CHECK(philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                   {0xffffffff, 0xffffffff}) ==
+        PhiloxCounter{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+  CHECK(philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                   {0xa4093822, 0x299f31d0}) ==
+        PhiloxCounter{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+  // the batched draws give the same words with any instruction set; 11
+  // counters fill the vectors and leave a tail
+  int const n = 11;
+  std::vector<std::uint32_t> counter0(n);
+  std::vector<std::uint32_t> counter1(n);
+  std::vector<std::uint32_t> counter2(n);
+  std::vector<std::uint32_t> key0(n);
+  std::vector<std::uint32_t> key1(n);
+  for (int i{0}; i < n; ++i) {
+    counter0[i] = 0x9E3779B9 * i;
+    counter1[i] = i;
+    counter2[i] = 0xffffffff - i;
+    key0[i] = 0x243f6a88 + i;
+    key1[i] = 0x85a308d3 ^ i;
+  }
+  for (auto simd : {Simd::None, Simd::Avx2, Simd::Avx512}) {
+    if (!is_supported(simd)) {
+      continue;
+    }
+    std::vector<std::uint32_t> words(3 * n);
+    philox_draw(counter0.data(), counter1.data(), counter2.data(), key0.data(),
+                key1.data(), words.data(), n, simd);
+    for (int i{0}; i < n; ++i) {
+      auto const random = philox4x32(
+          {counter0[i], counter1[i], counter2[i], 0}, {key0[i], key1[i]});
+      for (int j{0}; j < 3; ++j) {
+        CHECK(words[j * n + i] == random[j]);
+      }
+    }
+  }
+
+  CHECK(to_unit(0, 0) == 0.);
+  CHECK(to_unit(0xffffffff, 0xffffffff) < 1.);
+  CHECK(to_index(0, 5) == 0);
+  CHECK(to_index(0xffffffff, 5) == 4);
+}
+
+TEST_CASE("Test thread pool")
+{
+  ThreadPool pool(3);
+  std::vector<int> calls(3);
+  pool.run([&](int thread) { ++calls[thread]; });
+  pool.run([&](int thread) { ++calls[thread]; });
+  CHECK(calls == std::vector<int>{2, 2, 2});
+  CHECK_THROWS(pool.run([](int thread) {
+    if (thread == 2) {
+      throw std::runtime_error("failed");
+    }
+  }));
+  CHECK_THROWS(ThreadPool(0));
+
+  SUBCASE("A band throws before reaching the barrier")
+  {
+    // the others are released instead of waiting forever, and the exception
+    // of the failed band is the one rethrown
+    for (int failing : {0, 1, 2}) {
+      Barrier barrier{3};
+      auto const task = [&](int thread) {
+        if (thread == failing) {
+          throw std::runtime_error("failed");
+        }
+        barrier.arrive_and_wait();
+        barrier.arrive_and_wait();
+      };
+      CHECK_THROWS_WITH(pool.run(task, &barrier), "failed");
+      CHECK_THROWS(barrier.arrive_and_wait());
+    }
+    // the pool is still usable
+    Barrier barrier{3};
+    auto const task = [&](int thread) {
+      barrier.arrive_and_wait();
+      ++calls[thread];
+    };
+    pool.run(task, &barrier);
+    CHECK(calls == std::vector<int>{3, 3, 3});
+  }
+}
+
 TEST_CASE("Testing local heating")
 {
   double solar_luminosity = 1.;
@@ -151,6 +1006,23 @@ TEST_CASE("Testing local heating")
         doctest::Approx(30.).epsilon(0.1));
   CHECK(local_heating(solar_luminosity, 0.99) ==
         doctest::Approx(-252.).epsilon(0.1));
+  SUBCASE("table of the heating of each kind of daisy")
+  {
+    for (double luminosity : {0., 0.6, 1., 1.4}) {
+      auto const table = heating_table(luminosity);
+      for (auto [daisy, a] : {std::pair{Daisy::Black, Albedo::black},
+                              std::pair{Daisy::White, Albedo::white},
+                              std::pair{Daisy::Barren, Albedo::surface}}) {
+        double const absorbed = (1 - a) * luminosity;
+        double const heating =
+            absorbed > 0 ? 72. * std::log(absorbed) + 80. : 80.;
+        CHECK(table[static_cast<int>(daisy)] == heating);
+        Patch patch(daisy, 0., 0);
+        patch.absorb_light(luminosity);
+        CHECK(patch.temperature() == heating * 0.5);
+      }
+    }
+  }
 }
 
 TEST_CASE("Testing diffusion")
@@ -253,6 +1125,24 @@ TEST_CASE("Testing diffusion")
       CHECK(diffused_temperature[8] == doctest::Approx(0.));
     }
   }
+  SUBCASE("Interior temperature diffusion")
+  {
+    double diffusion_rate = 1.;
+    std::vector<double> temperatures(25, 0.);
+    temperatures[6] = 8.;
+    temperatures[18] = 16.;
+    std::vector<double> diffused_temperature(25);
+    diffuse(temperatures.data(), diffused_temperature.data(), 5,
+            diffusion_rate);
+    CHECK(sum_all(diffused_temperature) == doctest::Approx(24.));
+    CHECK(diffused_temperature[0] == doctest::Approx(1.));
+    CHECK(diffused_temperature[6] == doctest::Approx(0.));
+    CHECK(diffused_temperature[12] == doctest::Approx(3.));
+    CHECK(diffused_temperature[18] == doctest::Approx(0.));
+    CHECK(diffused_temperature[24] == doctest::Approx(2.));
+    CHECK(diffused_temperature[4] == doctest::Approx(0.));
+    CHECK(diffused_temperature == diffuse(temperatures, 5, diffusion_rate));
+  }
   SUBCASE("Multiple temperature diffusion")
   {
     SUBCASE("Diffusion rate 1")
@@ -272,4 +1162,44 @@ TEST_CASE("Testing diffusion")
       CHECK(diffused_temperature[8] == doctest::Approx(0.));
     }
   }
+  SUBCASE("Gathering matches spreading")
+  {
+    int const size = 37;
+    std::vector<double> temperatures(size * size);
+    for (int i{0}; i < size * size; ++i) {
+      temperatures[i] = 10. + (i * 7919 % 101) * 0.37;
+    }
+    for (double diffusion_rate : {0., 0.5, 1.}) {
+      auto const expected = scatter_diffuse(temperatures, size, diffusion_rate);
+      auto const diffused_temperature =
+          diffuse(temperatures, size, diffusion_rate);
+      for (int i{0}; i < size * size; ++i) {
+        CHECK(diffused_temperature[i] ==
+              doctest::Approx(expected[i]).epsilon(1e-14));
+      }
+    }
+  }
+  SUBCASE("Same result with every instruction set")
+  {
+    // with rates that are not dyadic, the products are rounded and any fused
+    // multiply-add would show up
+    for (double rate : {0.5, 0.3, 0.7}) {
+      for (int size : {1, 2, 3, 10, 37}) {
+        std::vector<double> temperatures(size * size);
+        for (int i{0}; i < size * size; ++i) {
+          temperatures[i] = (i * 7919 % 101) * 0.37 - 5.;
+        }
+        std::vector<double> expected(size * size);
+        diffuse(temperatures.data(), expected.data(), size, rate, Simd::None);
+        for (Simd simd : {Simd::Avx2, Simd::Avx512}) {
+          if (is_supported(simd)) {
+            std::vector<double> diffused_temperature(size * size);
+            diffuse(temperatures.data(), diffused_temperature.data(), size,
+                    rate, simd);
+            CHECK(diffused_temperature == expected);
+          }
+        }
+      }
+    }
+  }
 }
@@ -0,0 +1,160 @@
+#include "thread_pool.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+Barrier::Barrier(int n_threads) : n_threads_{n_threads}
+{
+  if (n_threads < 1) {
+    throw std::runtime_error("A barrier needs at least one thread");
+  }
+}
+
+void Barrier::arrive_and_wait()
+{
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (broken_) {
+    throw std::runtime_error("Broken barrier");
+  }
+  auto const generation = generation_;
+  if (++waiting_ == n_threads_) {
+    waiting_ = 0;
+    ++generation_;
+    all_arrived_.notify_all();
+    return;
+  }
+  all_arrived_.wait(lock,
+                    [&] { return broken_ || generation_ != generation; });
+  if (generation_ == generation) {
+    throw std::runtime_error("Broken barrier");
+  }
+}
+
+void Barrier::break_barrier()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    broken_ = true;
+  }
+  all_arrived_.notify_all();
+}
+
+ThreadPool::ThreadPool(int n_threads) : n_threads_{n_threads}
+{
+  if (n_threads < 1) {
+    throw std::runtime_error("A thread pool needs at least one thread");
+  }
+}
+
+ThreadPool::ThreadPool(ThreadPool const& other) : ThreadPool(other.n_threads_)
+{
+}
+
+ThreadPool& ThreadPool::operator=(ThreadPool const& other)
+{
+  if (this != &other) {
+    stop();
+    n_threads_ = other.n_threads_;
+  }
+  return *this;
+}
+
+ThreadPool::~ThreadPool()
+{
+  stop();
+}
+
+void ThreadPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  task_ready_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+  stopping_ = false;
+}
+
+void ThreadPool::work(int thread, std::uint64_t done)
+{
+  while (true) {
+    void (*call)(void const*, int);
+    void const* task;
+    Barrier* barrier;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      task_ready_.wait(lock, [&] { return stopping_ || generation_ != done; });
+      if (stopping_) {
+        return;
+      }
+      done = generation_;
+      call = call_;
+      task = task_;
+      barrier = barrier_;
+    }
+    try {
+      call(task, thread);
+    } catch (...) {
+      fail(barrier);
+    }
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (--running_ == 0) {
+      task_done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::fail(Barrier* barrier)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+  // the threads released throw in turn, after the first exception is kept
+  if (barrier != nullptr) {
+    barrier->break_barrier();
+  }
+}
+
+void ThreadPool::run_erased(void (*call)(void const*, int), void const* task,
+                            Barrier* barrier)
+{
+  if (n_threads_ == 1) {
+    call(task, 0);
+    return;
+  }
+  if (workers_.empty()) {
+    for (int thread{1}; thread < n_threads_; ++thread) {
+      workers_.emplace_back(
+          [this, thread, done = generation_] { work(thread, done); });
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    call_ = call;
+    task_ = task;
+    barrier_ = barrier;
+    running_ = n_threads_ - 1;
+    ++generation_;
+  }
+  task_ready_.notify_all();
+
+  try {
+    call(task, 0);
+  } catch (...) {
+    fail(barrier);
+  }
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  task_done_.wait(lock, [&] { return running_ == 0; });
+  auto const error = std::move(error_);
+  error_ = nullptr;
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
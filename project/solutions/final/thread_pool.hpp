@@ -0,0 +1,95 @@
+#if !defined(THREAD_POOL_H)
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Blocks the threads calling arrive_and_wait until n_threads of them have
+// called it; can be reused until it is broken.
+class Barrier
+{
+  int n_threads_;
+  int waiting_{0};
+  std::uint64_t generation_{0};
+  bool broken_{false};
+  std::mutex mutex_;
+  std::condition_variable all_arrived_;
+
+ public:
+  explicit Barrier(int n_threads);
+
+  // throws if the barrier is broken, before or while waiting
+  void arrive_and_wait();
+
+  // release the threads waiting, for one that will never arrive; from now on
+  // arrive_and_wait throws
+  void break_barrier();
+};
+
+// A fixed set of threads running the same task. The worker threads are
+// started by the first call to run, so a pool can be copied cheaply: the copy
+// has the same number of threads but starts its own.
+class ThreadPool
+{
+  int n_threads_{1};
+  std::vector<std::thread> workers_;
+  void (*call_)(void const*, int){nullptr};
+  void const* task_{nullptr};
+  Barrier* barrier_{nullptr};
+  std::uint64_t generation_{0};
+  int running_{0};
+  bool stopping_{false};
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable task_done_;
+
+  // run the tasks of the generations following done, until stopped
+  void work(int thread, std::uint64_t done);
+
+  void stop();
+
+  // keep the exception being handled, unless another one was kept already,
+  // and break the barrier, if any, the other threads may be waiting at
+  void fail(Barrier* barrier);
+
+  // call call(task, thread) on every thread
+  void run_erased(void (*call)(void const*, int), void const* task,
+                  Barrier* barrier);
+
+ public:
+  explicit ThreadPool(int n_threads = 1);
+
+  ThreadPool(ThreadPool const& other);
+
+  ThreadPool& operator=(ThreadPool const& other);
+
+  ~ThreadPool();
+
+  int size() const
+  {
+    return n_threads_;
+  }
+
+  // call task(thread) for every thread in [0, size()), concurrently, and
+  // return when all the calls have returned; the calling thread is thread 0.
+  // If any call throws, the first exception is rethrown. If the calls
+  // synchronize on barrier, it is broken as soon as one of them throws, so
+  // that the others don't wait for it forever. The task is not copied, so
+  // running it doesn't allocate.
+  template<typename Task>
+  void run(Task const& task, Barrier* barrier = nullptr)
+  {
+    run_erased(
+        [](void const* t, int thread) {
+          (*static_cast<Task const*>(t))(thread);
+        },
+        &task, barrier);
+  }
+};
+
+#endif  // THREAD_POOL_H
@@ -1,14 +1,88 @@
 #include "world.hpp"
 
+#include "async_output.hpp"
+#include "philox.hpp"
+
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
 #include <thread>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// bits 0, 3, 6, ..., 63
+constexpr std::uint64_t every_third = 0x9249249249249249;
+
+// bit i is set if bytes[i] is value, for n <= 64 bytes
+std::uint64_t byte_mask(std::uint8_t const* bytes, int n, std::uint8_t value)
+{
+  std::uint64_t mask{0};
+  int i{0};
+#if defined(__SSE2__)
+  auto const v = _mm_set1_epi8(static_cast<char>(value));
+  for (; i + 16 <= n; i += 16) {
+    auto const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes + i));
+    mask |= std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(b, v))) << i;
+  }
+#endif
+  for (; i < n; ++i) {
+    mask |= std::uint64_t(bytes[i] == value) << i;
+  }
+  return mask;
+}
+
+// the index of the n-th set bit of mask, from 0; with BMI2, the bit is
+// deposited there directly
+int nth_bit(unsigned mask, int n)
+{
+#if defined(__BMI2__)
+  return __builtin_ctz(_pdep_u32(1u << n, mask));
+#else
+  for (; n > 0; --n) {
+    mask &= mask - 1;
+  }
+  return __builtin_ctz(mask);
+#endif
+}
+
+// the sum of the n temperatures of a row, in four independent running sums
+// so that the additions overlap
+double sum_row(double const* temperatures, int n)
+{
+  double sums[4]{};
+  int i{0};
+  for (; i + 4 <= n; i += 4) {
+    for (int j{0}; j < 4; ++j) {
+      sums[j] += temperatures[i + j];
+    }
+  }
+  for (; i < n; ++i) {
+    sums[0] += temperatures[i];
+  }
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+}  // namespace
 
 World::World(int size, double start_black_percentage,
-             double start_white_percentage, int max_age)
-    : size_(size), max_age_{max_age}
+             double start_white_percentage, int max_age, int n_threads,
+             std::uint64_t seed)
+    : size_(size), max_age_{max_age}, pool_{n_threads}
 {
   if (start_black_percentage < 0 || start_white_percentage < 0) {
     throw std::runtime_error("Start pecentages must be >=0");
@@ -16,172 +90,723 @@ World::World(int size, double start_black_percentage,
   if (start_black_percentage + start_white_percentage > 1.) {
     throw std::runtime_error("Sum of start percentages greater than 1");
   }
+  if (max_age < 0 || max_age >= std::numeric_limits<std::uint16_t>::max()) {
+    throw std::runtime_error("Max age out of range");
+  }
   auto const size2{size * size};
-  patches_.reserve(size2);
+  std::vector<Patch> patches;
+  patches.reserve(size2);
 
+  std::mt19937_64 eng{seed};
   std::uniform_int_distribution<> flat{0, max_age_};
   // clang-format off
-  auto out = std::generate_n(std::back_inserter(patches_), size2 * start_black_percentage,
-                             [&]() { return Patch(Daisy::Black, 0., flat(eng_)); });
+  auto out = std::generate_n(std::back_inserter(patches), size2 * start_black_percentage,
+                             [&]() { return Patch(Daisy::Black, 0., flat(eng)); });
        out = std::generate_n(out, size2 * start_white_percentage,
-                             [&]() { return Patch(Daisy::White, 0., flat(eng_)); });
-             std::generate_n(out, size2 - patches_.size(),
-                             [&]() { return Patch(Daisy::Barren, 0., flat(eng_)); });
+                             [&]() { return Patch(Daisy::White, 0., flat(eng)); });
+             std::generate_n(out, size2 - patches.size(),
+                             [&]() { return Patch(Daisy::Barren, 0., flat(eng)); });
   // clang-format on
-  std::shuffle(patches_.begin(), patches_.end(), eng_);
+  std::shuffle(patches.begin(), patches.end(), eng);
+
+  temperature_.reserve(size2);
+  daisy_.reserve(size2);
+  age_.reserve(size2);
+  for (auto const& p : patches) {
+    temperature_.push_back(p.temperature());
+    daisy_.push_back(p.daisy());
+    age_.push_back(p.age());
+  }
+  resize_buffers();
+  seed_ = std::uniform_int_distribution<std::uint64_t>{}(eng);
+  count();
 }
 
-void World::spread()
+void World::resize_buffers()
+{
+  auto const size2 = std::size_t(size_) * size_;
+  next_temperature_.resize(size2);
+  next_daisy_.resize(size2);
+  next_age_.resize(size2);
+  seeds_.resize(size2);
+  target_word_.resize(size2);
+  barren_words_ = size_ / 64 + 2;
+  barren_.resize(std::size_t(size_) * barren_words_);
+  seed_words_ = (size_ + 63) / 64;
+  seed_bits_.resize(std::size_t(size_) * seed_words_);
+}
+
+void World::pack_rows(int first_row, int last_row)
 {
-  for (auto& patch : patches_) {
-    patch.age_and_die(max_age_);
+  auto const* const daisies =
+      reinterpret_cast<std::uint8_t const*>(next_daisy_.data());
+  std::uint8_t const barren = static_cast<std::uint8_t>(Daisy::Barren);
+  for (int row{first_row}; row < last_row; ++row) {
+    std::uint64_t* const barren_words = barren_.data() + row * barren_words_;
+    std::uint64_t* const seed_words = seed_bits_.data() + row * seed_words_;
+    std::fill_n(barren_words, barren_words_, 0);
+    // column col is bit col + 1 of the barren words, so the blocks of 64
+    // columns straddle two of them
+    for (int col{0}; col < size_; col += 64) {
+      int const idx = row * size_ + col;
+      int const n = std::min(64, size_ - col);
+      auto const mask = byte_mask(daisies + idx, n, barren);
+      barren_words[col / 64] |= mask << 1;
+      barren_words[col / 64 + 1] |= mask >> 63;
+      seed_words[col / 64] = byte_mask(seeds_.data() + idx, n, 1);
+    }
   }
-  auto new_patches = patches_;
+}
 
-  std::uniform_real_distribution<double> flat;
+unsigned World::barren_neighbors(int row, int col) const
+{
+  unsigned barren{0};
+  for (int r{std::max(row - 1, 0)}; r <= std::min(row + 1, size_ - 1); ++r) {
+    // columns col - 1, col and col + 1 are bits col to col + 2
+    std::uint64_t const* const words = barren_.data() + r * barren_words_;
+    int const shift = col % 64;
+    std::uint64_t bits = words[col / 64] >> shift;
+    if (shift > 61) {
+      bits |= words[col / 64 + 1] << (64 - shift);
+    }
+    barren |= unsigned(bits & 7) << (3 * (r - row + 1));
+  }
+  return barren;
+}
+
+void World::count()
+{
+  counts_ = {};
+  for (auto const daisy : daisy_) {
+    ++counts_[static_cast<int>(daisy)];
+  }
+  sum_temperatures();
+}
+
+std::vector<Patch> World::patches() const
+{
+  std::vector<Patch> patches;
+  patches.reserve(daisy_.size());
   for (int idx{0}; idx < size_ * size_; ++idx) {
-    auto& patch = patches_[idx];
-    if (patch.daisy() == Daisy::Barren ||
-        flat(eng_) >= patch.seeding_threshold()) {
-      continue;
-    }
-    std::vector<Patch*> barren_neighbors;
-    int const row = idx / size_;
-    int const col = idx % size_;
-    for (int neighborRow : {row - 1, row, row + 1}) {
-      for (int neighborCol : {col - 1, col, col + 1}) {
-        if (neighborRow >= 0 && neighborRow < size_ && neighborCol >= 0 &&
-            neighborCol < size_) {
-          auto& neighbor = new_patches[neighborRow * size_ + neighborCol];
-          if (neighbor.daisy() == Daisy::Barren) {
-            barren_neighbors.emplace_back(&neighbor);
-          }
+    patches.push_back(patch(idx));
+  }
+  return patches;
+}
+
+void World::age_and_propose(double const* temperatures, int first, int last,
+                            Counts& changes)
+{
+  // the patches are aged a batch at a time, without branches, then the words
+  // are drawn by the vectorized kernels for the living patches only
+  constexpr int batch = 256;
+  std::uint32_t living[batch];
+  std::uint32_t steps_low[batch];
+  std::uint32_t steps_high[batch];
+  std::uint32_t key0[batch];
+  std::uint32_t key1[batch];
+  std::uint32_t words[3 * batch];
+  std::fill_n(steps_low, batch, std::uint32_t(steps_));
+  std::fill_n(steps_high, batch, std::uint32_t(steps_ >> 32));
+  std::fill_n(key0, batch, std::uint32_t(seed_));
+  std::fill_n(key1, batch, std::uint32_t(seed_ >> 32));
+  std::uint16_t const* const ages = age_.data();
+  Daisy const* const daisies = daisy_.data();
+  std::uint16_t* const next_ages = next_age_.data();
+  Daisy* const next_daisies = next_daisy_.data();
+  std::uint8_t* const seeds = seeds_.data();
+  int const max_age = max_age_;
+  std::int64_t black_deaths{0};
+  std::int64_t white_deaths{0};
+  for (int start{first}; start < last; start += batch) {
+    int const end = std::min(start + batch, last);
+    for (int idx{start}; idx < end; ++idx) {
+      // barren patches keep aging too; their age is meaningless and may wrap
+      // around, since it's reset when a daisy sprouts
+      std::uint16_t const age = ages[idx] + 1;
+      Daisy const daisy = daisies[idx];
+      bool const dies = age > max_age;
+      black_deaths += dies & (daisy == Daisy::Black);
+      white_deaths += dies & (daisy == Daisy::White);
+      next_ages[idx] = age;
+      next_daisies[idx] = dies ? Daisy::Barren : daisy;
+      seeds[idx] = false;
+    }
+    int n{0};
+    for (int idx{start}; idx < end; ++idx) {
+      living[n] = idx;
+      n += next_daisies[idx] != Daisy::Barren;
+    }
+    philox_draw(living, steps_low, steps_high, key0, key1, words, n);
+    for (int i{0}; i < n; ++i) {
+      int const idx = living[i];
+      seeds[idx] = to_unit(words[i], words[n + i]) <
+                   seeding_threshold(temperatures[idx]);
+      target_word_[idx] = words[2 * n + i];
+    }
+  }
+  changes[static_cast<int>(Daisy::Black)] -= black_deaths;
+  changes[static_cast<int>(Daisy::White)] -= white_deaths;
+  changes[static_cast<int>(Daisy::Barren)] += black_deaths + white_deaths;
+}
+
+void World::sprout(int row, int col, Counts& changes)
+{
+  int const idx = row * size_ + col;
+  unsigned const barren = barren_neighbors(row, col);
+  if (barren == 0) {
+    return;
+  }
+  // the chosen barren neighbor is the n-th set bit
+  int const i =
+      nth_bit(barren, to_index(target_word_[idx], __builtin_popcount(barren)));
+  int const target_row = row + i / 3 - 1;
+  int const target_col = col + i % 3 - 1;
+  int const target = target_row * size_ + target_col;
+  barren_[target_row * barren_words_ + (target_col + 1) / 64] &=
+      ~(std::uint64_t{1} << (target_col + 1) % 64);
+  next_daisy_[target] = next_daisy_[idx];
+  next_age_[target] = 0;
+  ++changes[static_cast<int>(next_daisy_[idx])];
+  --changes[static_cast<int>(Daisy::Barren)];
+}
+
+void World::commit_seeds(int first_row, int last_row, Barrier& barrier,
+                         Counts& changes)
+{
+  // A seeding patch reads and writes only its 3x3 neighborhood. The patches
+  // are committed in 9 phases, one for each position within the 3x3 tiles of
+  // the grid: the neighborhoods of the patches of a phase don't overlap, so
+  // they can be committed concurrently.
+  for (int phase{0}; phase < 9; ++phase) {
+    int const row_offset = phase / 3;
+    int const col_offset = phase % 3;
+    int row{first_row + (row_offset - first_row % 3 + 3) % 3};
+    for (; row < last_row; row += 3) {
+      std::uint64_t const* const seeds = seed_bits_.data() + row * seed_words_;
+      for (int word{0}; word < seed_words_; ++word) {
+        // the columns of the phase, word * 64 + bit = col_offset modulo 3,
+        // knowing that 64 = 1 modulo 3
+        std::uint64_t bits =
+            seeds[word] & (every_third << (col_offset - word % 3 + 3) % 3);
+        for (; bits != 0; bits &= bits - 1) {
+          sprout(row, word * 64 + __builtin_ctzll(bits), changes);
         }
       }
     }
-    if (barren_neighbors.size() > 0) {
-      std::uniform_int_distribution<> flat_i(0, barren_neighbors.size() - 1);
-      barren_neighbors[flat_i(eng_)]->sprout(patch.daisy());
-    }
+    barrier.arrive_and_wait();
   }
-  patches_ = new_patches;
 }
 
-void World::print()
+void World::count_changes(int n_bands)
 {
-  for (int i{0}; i < size_; ++i) {
-    for (int j{0}; j < size_; ++j) {
-      std::cout << patches_[i * size_ + j];
+  for (int band{0}; band < n_bands; ++band) {
+    for (int d{0}; d < 3; ++d) {
+      counts_[d] += tallies_[band].changes[d];
     }
-    std::cout << "\n";
   }
-  std::cout << "\n";
 }
 
-void World::write_to_file(std::ofstream& out_file, double solar_luminosity)
+void World::sum_temperatures()
+{
+  KahanSum sum;
+  for (int row{0}; row < size_; ++row) {
+    sum.add(sum_row(temperature_.data() + row * size_, size_));
+  }
+  temperature_sum_ = sum.sum;
+}
+
+void World::spread()
 {
-  struct Sums
-  {
-    double global_t{0.};
-    int n_white{0};
-    int n_black{0};
-    int n_barren{0};
+  int const n_bands = pool_.size();
+  tallies_.resize(n_bands);
+  Barrier barrier{n_bands};
+  auto const spread_band = [&](int band) {
+    int const first_row = size_ * band / n_bands;
+    int const last_row = size_ * (band + 1) / n_bands;
+    auto& changes = tallies_[band].changes;
+    changes = {};
+    // whether a patch seeds, and the random word choosing its target, don't
+    // depend on the other patches
+    age_and_propose(temperature_.data(), first_row * size_,
+                    last_row * size_, changes);
+    pack_rows(first_row, last_row);
+    barrier.arrive_and_wait();
+    commit_seeds(first_row, last_row, barrier, changes);
   };
+  pool_.run(spread_band, &barrier);
+  count_changes(n_bands);
+  ++steps_;
+  std::swap(daisy_, next_daisy_);
+  std::swap(age_, next_age_);
+  active_tiles_.clear();
+}
+
 
-  auto sums = std::accumulate(patches_.begin(), patches_.end(), Sums{},
-                              [](Sums s, auto const& p) {
-                                s.global_t += p.temperature();
-                                switch (p.daisy()) {
-                                  case Daisy::White:
-                                    ++s.n_white;
-                                    break;
-                                  case Daisy::Black:
-                                    ++s.n_black;
-                                    break;
-                                  case Daisy::Barren:
-                                    ++s.n_barren;
-                                    break;
-                                }
-                                return s;
-                              });
-
-  sums.global_t /= patches_.size();
-
-  out_file << solar_luminosity << ',' << sums.global_t << ',' << sums.n_black
-           << ',' << sums.n_white << ',' << sums.n_barren << '\n';
+void World::write_to_file(std::ofstream& out_file, double solar_luminosity)
+{
+  auto const s = stats();
+  out_file << solar_luminosity << ',' << s.global_temperature << ','
+           << s.n_black << ',' << s.n_white << ',' << s.n_barren << '\n';
 }
 
-void World::compute_temperatures(double solar_luminosity)
+namespace {
+
+// heat n patches, writing their new temperatures into heated, which may be
+// temperatures
+void heat(HeatingTable const& heating, double const* temperatures,
+          Daisy const* daisies, double* heated, int n)
 {
-  for (auto& patch : patches_) {
-    patch.absorb_light(solar_luminosity);
+  for (int i{0}; i < n; ++i) {
+    heated[i] = (temperatures[i] + heating[static_cast<int>(daisies[i])]) * 0.5;
   }
 }
 
+}  // namespace
+
+void World::compute_temperatures(double solar_luminosity)
+{
+  heat(heating_table(solar_luminosity), temperature_.data(), daisy_.data(),
+       temperature_.data(), size_ * size_);
+  sum_temperatures();
+  active_tiles_.clear();
+}
+
 void World::compute_diffusion()
 {
-  std::vector<double> temperatures;
-  temperatures.reserve(patches_.size());
-  for (auto const& p : patches_) {
-    temperatures.push_back(p.temperature());
+  diffuse(temperature_.data(), next_temperature_.data(), size_, 0.5);
+  std::swap(temperature_, next_temperature_);
+  sum_temperatures();
+  active_tiles_.clear();
+}
+
+void World::sweep(HeatingTable const& heating, std::uint8_t const* active,
+                  double* heated_rows, int first_row, int last_row,
+                  Tally& tally)
+{
+  // the heated temperatures of row r are kept in heated_rows, in slot
+  // (r + 1) % 3: when row r is diffused, the slots hold rows r - 1, r and
+  // r + 1. The rows next to the band are heated as well, rather than waiting
+  // for the neighboring bands, since the heating doesn't change the current
+  // temperatures.
+  int const n_tiles = (size_ + sparse_tile - 1) / sparse_tile;
+  auto const heated = [&](int row) {
+    return heated_rows + (row + 1) % 3 * size_;
+  };
+  auto const tile_active = [&](int row, int tile) {
+    return active[row / sparse_tile * n_tiles + tile] != 0;
+  };
+  auto const heat_row = [&](int row) {
+    if (row < 0 || row >= size_) {
+      return;
+    }
+    double const* const temperatures = temperature_.data() + row * size_;
+    Daisy const* const daisies = daisy_.data() + row * size_;
+    if (active == nullptr) {
+      heat(heating, temperatures, daisies, heated(row), size_);
+      return;
+    }
+    // only the columns read by the active tiles of the rows around
+    for (int tile{0}; tile < n_tiles; ++tile) {
+      bool needed{false};
+      for (int r{std::max(row - 1, 0)}; r <= std::min(row + 1, size_ - 1);
+           ++r) {
+        needed = needed || tile_active(r, tile);
+      }
+      if (needed) {
+        int const first = std::max(tile * sparse_tile - 1, 0);
+        int const last = std::min((tile + 1) * sparse_tile + 1, size_);
+        heat(heating, temperatures + first, daisies + first,
+             heated(row) + first, last - first);
+      }
+    }
+  };
+  heat_row(first_row - 1);
+  heat_row(first_row);
+  tally.changes = {};
+  tally.temperature = {};
+  for (int row{first_row}; row < last_row; ++row) {
+    heat_row(row + 1);
+    double const* const up = row > 0 ? heated(row - 1) : nullptr;
+    double const* const down = row < size_ - 1 ? heated(row + 1) : nullptr;
+    double* const diffused = next_temperature_.data() + row * size_;
+    if (active == nullptr) {
+      diffuse_row(up, heated(row), down, diffused, size_, 0.5);
+    } else {
+      double const* const temperatures = temperature_.data() + row * size_;
+      for (int tile{0}; tile < n_tiles; ++tile) {
+        int const first = tile * sparse_tile;
+        int const last = std::min(first + sparse_tile, size_);
+        bool changed{false};
+        if (tile_active(row, tile)) {
+          diffuse_columns(up, heated(row), down, diffused, size_, 0.5, first,
+                          last);
+          for (int col{first}; col < last; ++col) {
+            changed = changed || !(std::abs(diffused[col] -
+                                            temperatures[col]) <=
+                                   sparse_tolerance_);
+          }
+          age_and_propose(next_temperature_.data(), row * size_ + first,
+                          row * size_ + last, tally.changes);
+        } else {
+          // the inactive tiles are barren, so they just age
+          std::copy(temperatures + first, temperatures + last,
+                    diffused + first);
+          for (int idx{row * size_ + first}; idx < row * size_ + last;
+               ++idx) {
+            next_age_[idx] = age_[idx] + 1;
+            next_daisy_[idx] = Daisy::Barren;
+            seeds_[idx] = false;
+          }
+        }
+        changed_[row * n_tiles + tile] = changed;
+      }
+    }
+    // the row was just written, so it's still in cache
+    tally.temperature.add(sum_row(diffused, size_));
+    if (active == nullptr) {
+      age_and_propose(next_temperature_.data(), row * size_,
+                      (row + 1) * size_, tally.changes);
+    }
+    pack_rows(row, row + 1);
+  }
+}
+
+void World::mark_daisies(int first_row, int last_row)
+{
+  int const n_tiles = (size_ + sparse_tile - 1) / sparse_tile;
+  for (int row{first_row}; row < last_row; ++row) {
+    for (int tile{0}; tile < n_tiles; ++tile) {
+      auto& changed = changed_[row * n_tiles + tile];
+      int const first = row * size_ + tile * sparse_tile;
+      int const last = row * size_ + std::min((tile + 1) * sparse_tile, size_);
+      auto const barren = [&](std::vector<Daisy> const& daisies) {
+        return std::count(daisies.begin() + first, daisies.begin() + last,
+                          Daisy::Barren) == last - first;
+      };
+      changed = changed || !barren(daisy_) || !barren(next_daisy_);
+    }
   }
+}
 
-  auto new_temperatures = diffuse(temperatures, size_, 0.5);
+void World::update_active_tiles()
+{
+  int const n_tiles = (size_ + sparse_tile - 1) / sparse_tile;
+  std::fill(active_tiles_.begin(), active_tiles_.end(), 0);
+  for (int row{0}; row < size_; ++row) {
+    for (int tile{0}; tile < n_tiles; ++tile) {
+      active_tiles_[row / sparse_tile * n_tiles + tile] |=
+          changed_[row * n_tiles + tile];
+    }
+  }
+  // the changed tiles and their neighbors: along the rows then along the
+  // columns, in place, keeping the value before the update of the previous
+  // tile
+  for (int r{0}; r < n_tiles; ++r) {
+    std::uint8_t* const tiles = active_tiles_.data() + r * n_tiles;
+    std::uint8_t previous{0};
+    for (int c{0}; c < n_tiles; ++c) {
+      std::uint8_t const tile = tiles[c];
+      tiles[c] |= previous | (c + 1 < n_tiles ? tiles[c + 1] : 0);
+      previous = tile;
+    }
+  }
+  for (int c{0}; c < n_tiles; ++c) {
+    std::uint8_t previous{0};
+    for (int r{0}; r < n_tiles; ++r) {
+      std::uint8_t* const tiles = active_tiles_.data() + c;
+      std::uint8_t const tile = tiles[r * n_tiles];
+      tiles[r * n_tiles] |=
+          previous | (r + 1 < n_tiles ? tiles[(r + 1) * n_tiles] : 0);
+      previous = tile;
+    }
+  }
+}
 
-  for (int i{0}; i < size_ * size_; ++i) {
-    patches_[i].temperature(new_temperatures[i]);
+namespace {
+
+// number of steps advanced per trip through memory, and the size of the two
+// buffers of a tile
+constexpr int block_steps = 8;
+constexpr int tile_bytes = 2 << 20;
+
+}  // namespace
+
+void World::advance_tile(HeatingTable const* heating, int n_steps,
+                         int first_row, int last_row, double* in, double* out)
+{
+  // the rows [lo, hi) are known after each step; they shrink by one row at
+  // each step on the sides not on the border of the grid. The buffers start
+  // at row first.
+  int lo = std::max(0, first_row - n_steps);
+  int hi = std::min(size_, last_row + n_steps);
+  int const first = lo;
+  auto const row = [&](double* buffer, int r) {
+    return buffer + (r - first) * size_;
+  };
+  std::copy(temperature_.data() + lo * size_, temperature_.data() + hi * size_,
+            in);
+  for (int s{0}; s < n_steps; ++s) {
+    heat(heating[s], row(in, lo), daisy_.data() + lo * size_, row(in, lo),
+         (hi - lo) * size_);
+    int const next_lo = lo == 0 ? 0 : lo + 1;
+    int const next_hi = hi == size_ ? size_ : hi - 1;
+    for (int r{next_lo}; r < next_hi; ++r) {
+      diffuse_row(r > 0 ? row(in, r - 1) : nullptr, row(in, r),
+                  r < size_ - 1 ? row(in, r + 1) : nullptr, row(out, r), size_,
+                  0.5);
+    }
+    std::swap(in, out);
+    lo = next_lo;
+    hi = next_hi;
   }
+  std::copy(row(in, first_row), row(in, last_row),
+            next_temperature_.data() + first_row * size_);
 }
 
-std::vector<double> diffuse(std::vector<double> const& temperatures, int size,
-                            double diffusion_rate)
+void World::advance(int n_steps,
+                    std::function<double(int)> const& luminosity,
+                    int tile_rows)
 {
-  std::vector<double> new_temperatures(size * size);
-  for (int idx{0}; idx < size * size; ++idx) {
-    double temperature = temperatures[idx];
-    double const diffused_temperature = temperature * diffusion_rate / 8;
-    int const row = idx / size;
-    int const col = idx % size;
-    for (int neighborRow : {row - 1, row, row + 1}) {
-      for (int neighborCol : {col - 1, col, col + 1}) {
-        // Check if the neighbor is within the grid bounds
-        if (neighborRow >= 0 && neighborRow < size && neighborCol >= 0 &&
-            neighborCol < size) {
-          new_temperatures[neighborRow * size + neighborCol] +=
-              diffused_temperature;
-          temperature -= diffused_temperature;
-        }
+  if (tile_rows < 0) {
+    throw std::runtime_error("Number of rows of the tiles must be >= 0");
+  }
+  std::vector<HeatingTable> heating;
+  heating.reserve(n_steps);
+  for (int i{0}; i < n_steps; ++i) {
+    heating.push_back(heating_table(luminosity(i)));
+  }
+  // by default, the tiles fit in tile_bytes, but have at least 4 times as
+  // many rows as the ones added around them, which are computed twice
+  if (tile_rows == 0) {
+    tile_rows = std::max(
+        8 * block_steps,
+        tile_bytes / int(2 * sizeof(double)) / std::max(size_, 1) -
+            2 * block_steps);
+  }
+  int const n_tiles = (size_ + tile_rows - 1) / tile_rows;
+  int const n_threads = pool_.size();
+  int const buffer_size = (tile_rows + 2 * block_steps) * size_;
+  tile_buffers_.resize(2 * buffer_size * n_threads);
+
+  for (int first_step{0}; first_step < n_steps; first_step += block_steps) {
+    int const n = std::min(block_steps, n_steps - first_step);
+    pool_.run([&](int thread) {
+      double* const buffers = tile_buffers_.data() + 2 * buffer_size * thread;
+      for (int tile{thread}; tile < n_tiles; tile += n_threads) {
+        advance_tile(heating.data() + first_step, n, tile * tile_rows,
+                     std::min(size_, (tile + 1) * tile_rows), buffers,
+                     buffers + buffer_size);
       }
-    }
-    // Keep leftover temperature
-    new_temperatures[idx] += temperature;
+    });
+    std::swap(temperature_, next_temperature_);
   }
-  // Update original patches
-  return new_temperatures;
+  sum_temperatures();
+  active_tiles_.clear();
+}
+
+void World::compute_step(HeatingTable const& heating,
+                         std::uint8_t const* active)
+{
+  // every thread sweeps a band of rows, heating, diffusing, aging and
+  // deciding which patches seed, then the seeds are committed; all but the
+  // commit read only the current state and write only the next one
+  int const n_bands = pool_.size();
+  heated_rows_.resize(3 * size_ * n_bands);
+  tallies_.resize(n_bands);
+  Barrier barrier{n_bands};
+  auto const step_band = [&](int band) {
+    int const first_row = size_ * band / n_bands;
+    int const last_row = size_ * (band + 1) / n_bands;
+    auto& tally = tallies_[band];
+    sweep(heating, active, heated_rows_.data() + 3 * size_ * band, first_row,
+          last_row, tally);
+    barrier.arrive_and_wait();
+    commit_seeds(first_row, last_row, barrier, tally.changes);
+    if (active != nullptr) {
+      mark_daisies(first_row, last_row);
+    }
+  };
+  pool_.run(step_band, &barrier);
 }
 
 void World::step(double solar_luminosity)
 {
-  compute_temperatures(solar_luminosity);
-  compute_diffusion();
-  spread();
+  auto const heating = heating_table(solar_luminosity);
+  bool const sparse = sparse_tolerance_ >= 0.;
+  std::uint8_t const* active{nullptr};
+  if (sparse) {
+    int const n_tiles = (size_ + sparse_tile - 1) / sparse_tile;
+    if (active_tiles_.empty() || heating != sparse_heating_) {
+      active_tiles_.assign(n_tiles * n_tiles, 1);
+    }
+    sparse_heating_ = heating;
+    changed_.resize(size_ * n_tiles);
+    active = active_tiles_.data();
+  }
+  std::vector<double> dense_temperatures;
+  std::vector<Daisy> dense_daisies;
+  std::vector<std::uint16_t> dense_ages;
+  if (sparse && sparse_check_) {
+    compute_step(heating, nullptr);
+    dense_temperatures = next_temperature_;
+    dense_daisies = next_daisy_;
+    dense_ages = next_age_;
+  }
+  compute_step(heating, active);
+  if (sparse && sparse_check_) {
+    if (next_daisy_ != dense_daisies || next_age_ != dense_ages) {
+      throw std::runtime_error("Sparse step with other daisies than dense");
+    }
+    for (std::size_t idx{0}; idx < dense_temperatures.size(); ++idx) {
+      if (!(std::abs(next_temperature_[idx] - dense_temperatures[idx]) <=
+            sparse_tolerance_)) {
+        throw std::runtime_error(
+            "Sparse step with other temperatures than dense");
+      }
+    }
+  }
+  if (sparse) {
+    update_active_tiles();
+  }
+  int const n_bands = pool_.size();
+  count_changes(n_bands);
+  KahanSum sum;
+  for (int band{0}; band < n_bands; ++band) {
+    sum.add(tallies_[band].temperature.sum);
+  }
+  temperature_sum_ = sum.sum;
+  ++steps_;
+  std::swap(temperature_, next_temperature_);
+  std::swap(daisy_, next_daisy_);
+  std::swap(age_, next_age_);
+}
+
+void World::set_sparse(double tolerance, bool check)
+{
+  sparse_tolerance_ = tolerance;
+  sparse_check_ = check;
+  active_tiles_.clear();
+}
+
+double World::active_fraction() const
+{
+  if (sparse_tolerance_ < 0. || active_tiles_.empty()) {
+    return 1.;
+  }
+  return double(std::count(active_tiles_.begin(), active_tiles_.end(), 1)) /
+         active_tiles_.size();
+}
+
+namespace {
+
+void print_daisies(std::vector<Daisy> const& daisies, int size)
+{
+  for (int i{0}; i < size; ++i) {
+    for (int j{0}; j < size; ++j) {
+      std::cout << Patch(daisies[i * size + j], 0., 0);
+    }
+    std::cout << "\n";
+  }
+  std::cout << "\n";
+}
+
+// the last daisies published by the simulation for the screen
+struct Frame
+{
+  std::mutex mutex;
+  std::condition_variable published;
+  std::vector<Daisy> daisies;
+  int iteration{0};
+  bool done{false};
+};
+
+}  // namespace
+
+void World::print()
+{
+  print_daisies(daisy_, size_);
 }
 
-void simulate(World world, int iterations, bool print_to_screen)
+void simulate(World world, int iterations, bool print_to_screen,
+              int n_threads, int max_fps)
 {
-  int it{0};
+  if (max_fps < 1) {
+    throw std::runtime_error("Frames per second must be >= 1");
+  }
+  world.set_threads(n_threads);
   double solar_luminosity(1);
-  std::ofstream out_file("data.csv");
-  out_file << "Solar luminosity, Global temperature, Black daisies, White "
-              "daisies, Barren lands\n";
-  while (it++ < iterations) {
-    world.step(solar_luminosity);
-    std::cout << "\033c";
-    if (print_to_screen) {
-      world.print();
-    }
-    world.write_to_file(out_file, solar_luminosity);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-  }
-  out_file.close();
+  // the stats are written to data.csv by a thread of its own
+  AsyncOutput output({"data.csv", "", ""}, world.size());
+
+  if (!print_to_screen) {
+    for (int it{0}; it < iterations; ++it) {
+      world.step(solar_luminosity);
+      output.publish(make_stats(world, it + 1, solar_luminosity));
+    }
+    output.close();
+    return;
+  }
+
+  // the simulation runs ahead on its own thread, publishing a copy of the
+  // daisies at most max_fps times per second; this thread shows them
+  using clock = std::chrono::steady_clock;
+  auto const frame_time =
+      std::chrono::duration_cast<clock::duration>(std::chrono::seconds{1}) /
+      max_fps;
+  int const size = world.size();
+  Frame frame;
+  frame.daisies = world.daisies();
+  std::exception_ptr error;
+  std::thread simulation([&] {
+    try {
+      auto next_frame = clock::now();
+      for (int it{0}; it < iterations; ++it) {
+        world.step(solar_luminosity);
+        output.publish(make_stats(world, it + 1, solar_luminosity));
+        if (clock::now() >= next_frame || it + 1 == iterations) {
+          std::lock_guard<std::mutex> lock{frame.mutex};
+          frame.daisies = world.daisies();
+          frame.iteration = it + 1;
+          frame.published.notify_one();
+          next_frame = clock::now() + frame_time;
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock{frame.mutex};
+    frame.done = true;
+    frame.published.notify_one();
+  });
+
+  std::vector<Daisy> daisies;
+  int shown{-1};
+  bool done{false};
+  while (!done) {
+    auto const next_frame = clock::now() + frame_time;
+    bool show{false};
+    {
+      std::unique_lock<std::mutex> lock{frame.mutex};
+      frame.published.wait(
+          lock, [&] { return frame.done || frame.iteration != shown; });
+      done = frame.done;
+      if (frame.iteration != shown) {
+        daisies = frame.daisies;
+        shown = frame.iteration;
+        show = true;
+      }
+    }
+    if (show) {
+      std::cout << "\033c";
+      print_daisies(daisies, size);
+    }
+    if (!done) {
+      std::this_thread::sleep_until(next_frame);
+    }
+  }
+  simulation.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  output.close();
 }
@@ -1,24 +1,218 @@
 #if !defined(WORLD_H)
 #define WORLD_H
+#include "diffusion.hpp"
 #include "patch.hpp"
+#include "thread_pool.hpp"
 
+#include <array>
+#include <cstdint>
 #include <fstream>
-#include <random>
+#include <functional>
+#include <string>
+#include <vector>
+
+// the population of a world and its mean temperature
+struct WorldStats
+{
+  std::uint64_t n_black{0};
+  std::uint64_t n_white{0};
+  std::uint64_t n_barren{0};
+  double global_temperature{0.};
+};
+
+// a sum compensating the rounding errors of its additions (Kahan)
+struct KahanSum
+{
+  double sum{0.};
+  double compensation{0.};
+
+  void add(double value)
+  {
+    double const y = value - compensation;
+    double const t = sum + y;
+    compensation = (t - sum) - y;
+    sum = t;
+  }
+};
+
+class WorldBatch;
+
+// side of the tiles tracked by the sparse steps
+constexpr int sparse_tile = 32;
 
 class World
 {
+  // a batch reads and writes the state of its worlds
+  friend class WorldBatch;
+
+  // numbers of daisies, indexed by Daisy
+  using Counts = std::array<std::int64_t, 3>;
+
+  // what a band of rows changes in the stats during a step, on a cache line
+  // of its own
+  struct alignas(64) Tally
+  {
+    Counts changes{};
+    KahanSum temperature;
+  };
+
   int size_{0};
   int max_age_{0};
-  std::vector<Patch> patches_;
-  std::default_random_engine eng_{};
+  // the patches are stored as a structure of arrays: the state of patch i is
+  // given by the i-th element of each vector
+  std::vector<double> temperature_;
+  std::vector<Daisy> daisy_;
+  std::vector<std::uint16_t> age_;
+  // buffers receiving the diffused temperatures and the spread daisies,
+  // swapped with the current ones
+  std::vector<double> next_temperature_;
+  std::vector<Daisy> next_daisy_;
+  std::vector<std::uint16_t> next_age_;
+  // the random numbers of spread are drawn from a counter-based generator,
+  // keyed on the seed, the number of steps and the index of the patch
+  std::uint64_t seed_{0};
+  std::uint64_t steps_{0};
+  // for each patch, whether it seeds in this step and, if so, the random word
+  // choosing its target
+  std::vector<std::uint8_t> seeds_;
+  std::vector<std::uint32_t> target_word_;
+  // the barren patches of the next daisies, a bit per patch: column col of
+  // row r is bit col + 1 of the barren_words_ words of the row, and the bits
+  // outside the grid are clear, so the barren neighbors of a patch are a
+  // few shifts away. A sprout clears the bit of its target.
+  std::vector<std::uint64_t> barren_;
+  int barren_words_{0};
+  // the seeds, a bit per patch: column col of row r is bit col of the
+  // seed_words_ words of the row, so the seeds of a phase of the commit are
+  // found a word at a time
+  std::vector<std::uint64_t> seed_bits_;
+  int seed_words_{0};
+  // threads computing step, each on a band of rows
+  ThreadPool pool_;
+  // for each band, the 3 rows of heated temperatures read by the diffusion
+  // of the row in the middle
+  std::vector<double> heated_rows_;
+  // for each thread, the two buffers of the tiles of advance
+  std::vector<double> tile_buffers_;
+  // the stats, kept up to date by the steps: the daisies are counted as they
+  // die and sprout, the temperatures are summed as they are diffused
+  Counts counts_{};
+  double temperature_sum_{0.};
+  std::vector<Tally> tallies_;
+  // the tracking of the quiescent tiles (see set_sparse): the heating of the
+  // last step, whether each tile is active in the next step, empty when they
+  // all are, and whether the tiles of each row have changed in the last step
+  double sparse_tolerance_{-1.};
+  bool sparse_check_{false};
+  HeatingTable sparse_heating_{};
+  std::vector<std::uint8_t> active_tiles_;
+  std::vector<std::uint8_t> changed_;
+
+  // sum the temperatures again, after changing them all
+  void sum_temperatures();
+
+  // count the daisies and sum the temperatures again, after setting them
+  void count();
+
+  // size the next buffers and the seeds for the grid
+  void resize_buffers();
+
+  // age the patches [first, last) and decide whether they seed, given their
+  // temperatures, counting the daisies dying in changes
+  void age_and_propose(double const* temperatures, int first, int last,
+                       Counts& changes);
+
+  // commit the seeds of the rows [first_row, last_row), in 9 phases
+  // separated by the barrier, counting the daisies sprouting in changes
+  void commit_seeds(int first_row, int last_row, Barrier& barrier,
+                    Counts& changes);
+
+  // heat, diffuse, age and propose the seeds of the rows [first_row,
+  // last_row) in a single sweep, into the next buffers, summing the new
+  // temperatures in tally; with active, only the active tiles are heated and
+  // diffused, and the changes of the tiles are marked
+  void sweep(HeatingTable const& heating, std::uint8_t const* active,
+             double* heated_rows, int first_row, int last_row, Tally& tally);
+
+  // mark the tiles of the rows [first_row, last_row) with daisies before or
+  // after the step as changed
+  void mark_daisies(int first_row, int last_row);
+
+  // compute the next step into the next buffers, and the changes of the
+  // stats in the tallies
+  void compute_step(HeatingTable const& heating, std::uint8_t const* active);
+
+  // the tiles active in the next step: those next to a changed one
+  void update_active_tiles();
+
+  // heat and diffuse n_steps times the rows [first_row, last_row) into
+  // next_temperature_, in the two buffers
+  void advance_tile(HeatingTable const* heating, int n_steps, int first_row,
+                    int last_row, double* in, double* out);
+
+  // set the barren bits and the seed bits of the rows [first_row,
+  // last_row) from the next daisies and the seeds
+  void pack_rows(int first_row, int last_row);
+
+  // bit i is set if the neighbor at offset i of the 3x3 neighborhood of the
+  // patch, in row-major order, is within the grid and barren
+  unsigned barren_neighbors(int row, int col) const;
+
+  // sprout the daisy of a patch into one of its barren neighbors
+  void sprout(int row, int col, Counts& changes);
+
+  // add the changes of the bands to the counts
+  void count_changes(int n_bands);
 
  public:
+  // worlds built with different seeds have different initial layouts and
+  // draw different random numbers; the same seed gives the same run
   World(int size, double start_black_percentage, double start_white_percentage,
-        int max_age);
+        int max_age, int n_threads = 1, std::uint64_t seed = 0);
 
-  std::vector<Patch> const& patches() const
+  int size() const
   {
-    return patches_;
+    return size_;
+  }
+
+  int threads() const
+  {
+    return pool_.size();
+  }
+
+  void set_threads(int n_threads)
+  {
+    pool_ = ThreadPool(n_threads);
+  }
+
+  Patch patch(int idx) const
+  {
+    return Patch(daisy_[idx], temperature_[idx], age_[idx]);
+  }
+
+  std::vector<Patch> patches() const;
+
+  std::vector<double> const& temperatures() const
+  {
+    return temperature_;
+  }
+
+  std::vector<Daisy> const& daisies() const
+  {
+    return daisy_;
+  }
+
+  std::vector<std::uint16_t> const& ages() const
+  {
+    return age_;
+  }
+
+  // the stats of the current state, without going through the patches
+  WorldStats stats() const
+  {
+    return {std::uint64_t(counts_[0]), std::uint64_t(counts_[1]),
+            std::uint64_t(counts_[2]),
+            temperature_sum_ / (double(size_) * size_)};
   }
 
   void spread();
@@ -31,12 +225,48 @@ class World
 
   void step(double solar_luminosity);
 
+  // Skip the heating and the diffusion of the quiescent parts of the grid in
+  // the next steps. The grid is split into tiles of sparse_tile x sparse_tile
+  // patches; a tile changes in a step if it has daisies before or after it,
+  // or if the temperature of one of its patches changes by more than
+  // tolerance. Only the tiles next to a tile that changed in the last step
+  // are heated and diffused, the others keep their temperatures; all of them
+  // are after a change of luminosity. With a tolerance of 0, the steps are
+  // the same as the dense ones; a negative tolerance goes back to dense
+  // steps. With check, every step is computed densely as well, and throws if
+  // the daisies or the ages differ, or a temperature differs by more than
+  // tolerance.
+  void set_sparse(double tolerance, bool check = false);
+
+  // the fraction of the tiles heated and diffused in the next step, 1 with
+  // dense steps
+  double active_fraction() const;
+
+  // Heat and diffuse the temperatures n_steps times, the i-th time with the
+  // luminosity luminosity(i), without spreading the daisies: the same as
+  // calling compute_temperatures and compute_diffusion n_steps times. The
+  // grid is split into tiles of rows advanced several steps at a time while
+  // they are in cache, each tile with enough rows around it to compute them;
+  // tile_rows is the number of rows of a tile, 0 to fit it in cache.
+  void advance(int n_steps, std::function<double(int)> const& luminosity,
+               int tile_rows = 0);
+
   void write_to_file(std::ofstream& outFile, double solar_luminosity);
-};
 
-std::vector<double> diffuse(std::vector<double> const& temperatures, int size,
-                            double diffusion_rate);
+  // write the whole state to a checkpoint file (see checkpoint.cpp), from
+  // which restore continues the run bit-identically
+  void checkpoint(std::string const& path) const;
+
+  // the world saved in a checkpoint file, stepped by n_threads threads
+  static World restore(std::string const& path, int n_threads = 1);
+};
 
-void simulate(World world, int iterations, bool print_to_screen);
+// Run iterations steps of the world, writing the statistics of each step to
+// data.csv from another thread. Without print_to_screen, the steps run at full
+// speed with no output; with it, they run at full speed on another thread
+// while this one shows their daisies at most max_fps times per second, always
+// showing the final ones.
+void simulate(World world, int iterations, bool print_to_screen,
+              int n_threads = 1, int max_fps = 10);
 
 #endif  // WORLD_H